@@ -27,223 +27,173 @@
 #include <xc.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include "nucleo.h"
+#include "hw.h"
 
 /*------------------------------------------------------------------------------
  * CONSTANTES 
  ------------------------------------------------------------------------------*/
 #define _XTAL_FREQ 1000000      // Frecuencia de oscilador en 1 MHz
-#define IN_MIN 0                
-#define IN_MAX 255              // Valores de entrada a Potenciometro
-#define IN_MIN2 5              // Valores de entrada a Potenciometro
-#define IN_MAX2 127              // Valores de entrada a Potenciometro  
-#define OUT_MIN3 0          // Valores de entrada a Potenciometro
-#define OUT_MAX3 255              // Valores de entrada a Potenciometro  
-#define OUT_MIN1 135             
-#define OUT_MAX1 580             // Valores para el servomotor MG996R ---> en realidad debera de ser 125 y 600 pero se disminuyeron para que giraran casi 180 grados
+#define BAUD_SPBRG 25           // Fosc/(4*(n+1)): 25 -> 9600, 12 -> 19200 (error 0.16%)
+
+// Marcapasos con TMR1: un tick cada 50 ms (Fosc/4 = 250 kHz, prescaler 1:1)
+#define TMR1_CARGA (65536 - 12500)
+// Velocidad del MSSP cuando TRANSPORTE_I2C (nucleo.h) vale 1
+#define I2C_SSPADD 2            // Fosc/(4*(SSPADD+1)) = 83 kHz
+#define EE_TAM 8                // Escrituras pendientes de la EEPROM (potencia de 2); un registro son 7
+#define EE_MASK (EE_TAM - 1)
+
+// Secuenciador del ADC: TMR0 inicia una conversin cada 250 cuentas de 8 us
+// (Fosc/4 con prescaler 1:2), es decir cada 2 ms. Con 4 canales en la tabla
+// cada potencimetro se muestrea a 125 Hz
+#define TMR0_CARGA 6
+#define N_CANALES sizeof(CANALES_ADC)
+
+// Medicin de tiempos: con MEDIR_ISR en 1, RD7 queda en alto mientras dura
+// isr() y RD6/RD5/RD4 mientras se atiende el PORTB, el ADC y la USART, para
+// medir ciclos por ruta y latencia en simulador (gpsim) o analizador lgico
+#ifndef MEDIR_ISR
+#define MEDIR_ISR 0             // make medir_isr compila con -DMEDIR_ISR=1
+#endif
+#if MEDIR_ISR
+#define MARCA(pin, v)       (PORTDbits.pin = (v))
+#else
+#define MARCA(pin, v)
+#endif
 
 /*------------------------------------------------------------------------------
  * VARIABLES 
  ------------------------------------------------------------------------------*/
-uint8_t MODO = 0;                           // Variable para el cambio de modo
-unsigned short POT_1_M;                     // Valor de lectura del potencimetro 1 
-unsigned short POT_2_M;                     // Valor de lectura del potencimetro 2 
-uint8_t POT_1;                              // Valor de lectura del potencimetro 1 
-uint8_t POT_2;                              // Valor de lectura del potencimetro 2 
-uint8_t POT_3;                              // Valor de lectura del potencimetro 3 
-uint8_t POT_4;                              // Valor de lectura del potencimetro 4 
-uint8_t POT_1_E;                              // Valor de lectura del potencimetro 1 
-uint8_t POT_2_E;                              // Valor de lectura del potencimetro 2 
-uint8_t POT_3_E;                              // Valor de lectura del potencimetro 3 
-uint8_t POT_4_E;                              // Valor de lectura del potencimetro 4
-uint8_t BANDERA_L1, BANDERA_L2;             // Bandera de lectura
-uint8_t BANDERA_E1, BANDERA_E2;             // Bandera de escritura
-uint8_t BANDERA_R;
-uint8_t SELECCION_SERVO = 0;                    // Variable para seleccion de servomotor
-uint8_t VALORPOT_USART;                     // Variable que almacena el valor del servomotor
-uint8_t CONT;
-uint8_t CONT3;
-uint8_t BANDERA_USART;
-uint8_t VALOR_USART;
-uint8_t BANDERA_MODO2A0;
-char VALORES[2];
+#if CS_DECODIFICADOR
+const uint8_t CS_DIRECCION[8] = {0, 1, 2, 3, 4, 5, 6, 7};  // Salida Yn del 74HC138 por esclavo
+#else
+// Pines libres en esta placa, por esclavo. Ninguno en PORTB: HW_SPI_CS hace
+// lectura-modificacin-escritura del puerto desde isr() y en PORTB eso
+// rearma el interrupt-on-change de RB0 - RB2 (ver HW_LATCH). RA4 es tambin
+// T0CKI, libre porque TMR0 usa el reloj interno
+const struct CHIP_SELECT CS_PINES[8] = {
+    {&PORTA, 0b01000000}, {&PORTA, 0b10000000},             // RA6, RA7
+    {&PORTD, 0b00000001}, {&PORTD, 0b00000010},             // RD0, RD1
+    {&PORTD, 0b00000100}, {&PORTD, 0b00001000},             // RD2, RD3
+    {&PORTC, 0b00000001}, {&PORTA, 0b00010000}              // RC0, RA4
+};
+#endif
+uint8_t DATO_USART;                         // Byte ledo de RCREG en la interrupcin
+
+struct ESCRITURA {                          // Byte pendiente de escribir en la EEPROM
+    uint8_t DIRECCION;
+    uint8_t DATO;
+};
+struct ESCRITURA COLA_EEPROM[EE_TAM];       // Cola circular de escrituras
+volatile uint8_t EE_INICIO;                 // Siguiente escritura a iniciar (interrupcin)
+uint8_t EE_FIN;                             // Siguiente entrada libre (main)
+volatile uint8_t EEPROM_OCUPADA;            // 1 mientras queden escrituras por terminar
+uint8_t EE_OMITIDAS;                        // Escrituras omitidas porque el byte no cambi
 
+const uint8_t CANALES_ADC[] = {0, 1, 2, 3}; // Orden de muestreo de los canales
+uint8_t INDICE_ADC;                         // Posicin actual en CANALES_ADC
 
 /*------------------------------------------------------------------------------
  * PROTOTIPO DE FUNCIONES 
  ------------------------------------------------------------------------------*/
 void setup(void);
-unsigned short map(short val, uint8_t in_min, uint8_t in_max, 
-            unsigned short out_min, unsigned short out_max);
-void ESCRITURA_EEPROM(uint8_t DIRECCION, uint8_t DATA);
-uint8_t LECTURA_EEPROM(uint8_t DIRECCION);
+void EEPROM_SIGUIENTE(void);
 
 /*------------------------------------------------------------------------------
  * INTERRUPCIONES 
  ------------------------------------------------------------------------------*/
 void __interrupt() isr (void){
+    MARCA(RD7, 1);
     if(INTCONbits.RBIF){                    // Verificacin de interrupcin del PORTB
-        if(!PORTBbits.RB0){                 // Verificacin de interrupcin de RB0
-            MODO++;                         // Incremento para cambio de modo por presionar el botn
-            if (MODO > 2){                  // Condicional que no exceda de tres estados 
-                MODO = 0;                   // Reinicio del modo
-            }
-            
-            /*if(MODO == 0){
-                BANDERA_MODO2A0 = 1;
-            }*/
-        }
-        else if(!PORTBbits.RB1){            // Verificacin de interrupcin de RB1
-            if(MODO == 0){
-                BANDERA_E1 = 1;
-            }
-            else if(MODO == 1){
-                BANDERA_L1 = 1;
-            }           
-        }
-        else if(!PORTBbits.RB2){            // Verificacin de interrupcin de RB1
-            if(MODO == 0){
-                BANDERA_E2 = 1;
-            }
-            else if(MODO == 1){
-                BANDERA_L2 = 1;
-            }           
-        }
+        MARCA(RD6, 1);
+        NUCLEO_BOTONES(HW_BOTONES());
         INTCONbits.RBIF = 0;                // Limpieza de bandera de interrupcin del PORTB
+        MARCA(RD6, 0);
+    }
+
+    if(INTCONbits.T0IF){                    // Periodo de muestreo del ADC
+        TMR0 = TMR0_CARGA;                  // Recarga de TMR0
+        NUCLEO_MUESTREO();
+        if(ADCON0bits.GO == 0){
+            ADCON0bits.GO = 1;              // Conversin del canal ya adquirido
+        }
+        INTCONbits.T0IF = 0;                // Limpieza de bandera de TMR0
+    }
+
+    if(PIR1bits.TMR1IF){                    // Tick de 50 ms del marcapasos
+        TMR1H = TMR1_CARGA>>8;              // Recarga de TMR1
+        TMR1L = TMR1_CARGA & 0xFF;
+        NUCLEO_TICK();
+        PIR1bits.TMR1IF = 0;                // Limpieza de bandera de TMR1
     }
 
     if(PIR1bits.ADIF){                      // Verificacin de interrupcin del mdulo ADC
-        if(ADCON0bits.CHS == 0){        // Verificacin de canal AN0
-            if(MODO == 0){
-                if(BANDERA_MODO2A0 == 1){
-                    __delay_ms(1000);
-                    CONT3++;
-                }
-                POT_1 = ADRESH;
-                POT_1_M = map(POT_1, IN_MIN, IN_MAX, OUT_MIN1, OUT_MAX1);    // Almacenar el resgitro ADRESH en variable POT1
-            }
-            else if (MODO == 1){
-                if(BANDERA_R == 1){
-                    __delay_ms(1000);
-                    CONT++;
-                }
-                POT_1_E = POT_1;
-                POT_1_M = map(POT_1, IN_MIN, IN_MAX, OUT_MIN1, OUT_MAX1);
-            }
-            else if(MODO == 2){
-                POT_1_M = map(POT_1_E, IN_MIN2, IN_MAX2, OUT_MIN1, OUT_MAX1);    // Almacenar el resgitro ADRESH en variable POT1
-            }
-            
-            CCPR1L = (uint8_t)(POT_1_M>>2);                               // 8 bits mas significativos en CPR1L
-            CCP1CONbits.DC1B = POT_1_M & 0b11;                            // 2 bits menos significativos en DC1B
-            
-        } 
-        else if(ADCON0bits.CHS == 1){   // Verificacin de canal AN1
-            if(MODO == 0){
-                if(BANDERA_MODO2A0 == 1){
-                    __delay_ms(1000);
-                    CONT3++;
-                }
-                POT_2 = ADRESH;
-                POT_2_M = map(POT_2, IN_MIN, IN_MAX, OUT_MIN1, OUT_MAX1);    // Almacenar el resgitro ADRESH en variable POT2
-            }
-            else if (MODO == 1){
-                if(BANDERA_R == 1){
-                    __delay_ms(1000);
-                    CONT++;
-                }
-                POT_2_M = map(POT_2, IN_MIN, IN_MAX, OUT_MIN1, OUT_MAX1);
-            }
-            else if(MODO == 2){
-                POT_2_M = map(POT_2_E, IN_MIN2, IN_MAX2, OUT_MIN1, OUT_MAX1);    // Almacenar el resgitro ADRESH en variable POT1
-            }
-            
-            CCPR2L = (uint8_t)(POT_2_M>>2);                               // 8 bits mas significativos en CPR1L 01010101"01" -> 01010101
-            CCP2CONbits.DC2B0 = POT_2_M & 0b01; 
-            CCP2CONbits.DC2B1 = (POT_2_M & 0b10)>>1;                      // 2 bits menos significativos en DC2B0 y DC2B1
-        } 
-        else if(ADCON0bits.CHS == 2){       // Verificacin de canal AN2
-            if(MODO == 0){
-                if(BANDERA_MODO2A0 == 1){
-                    __delay_ms(1000);
-                    CONT3++;
-                }
-                POT_3 = ADRESH;             // Almacenar el resgitro ADRESH en variable POT3
-            }
-            else if (MODO == 1){
-                if(BANDERA_R == 1){
-                    __delay_ms(1000);
-                    CONT++;
-                }
-            }
-            else if(MODO == 2){
-                POT_3 = map(POT_3_E, IN_MIN2, IN_MAX2, OUT_MIN3, OUT_MAX3);    // Almacenar el resgitro ADRESH en variable POT1
-            }
-            
-            PORTDbits.RD0 = 0;              // Pin RD0 de salida en encendido para habilitar el CCP1 del ESCLAVO1
-            SSPBUF = POT_3;                 // Cargamos valor del potencimetro al buffer
-            while(!SSPSTATbits.BF){}        // Esperamos a que termine el envio
-            __delay_ms(50);                 // Sample time para el cambio
-            
-        } 
-        else if(ADCON0bits.CHS == 3){       // Verificacin de canal AN3
-            if(MODO == 0){
-                if(BANDERA_MODO2A0 == 1){
-                    __delay_ms(1000);
-                    CONT3++;
-                }
-                POT_4 = ADRESH;             // Almacenar el resgitro ADRESH en variable POT4
-            }
-            else if (MODO == 1){
-                if(BANDERA_R == 1){
-                    __delay_ms(1000);
-                    CONT++;
-                }
-            }
-            else if(MODO == 2){
-                POT_4 = map(POT_4_E, IN_MIN2, IN_MAX2, OUT_MIN3, OUT_MAX3);    // Almacenar el resgitro ADRESH en variable POT1
-            }
-            
-            PORTDbits.RD0 = 1;              // Pin RD0 de salida apagado pues no se habilita el CCP1 del ESCLAVO1
-            SSPBUF = POT_4;                 // Cargamos valor del potencimetro al buffer
-            while(!SSPSTATbits.BF){}        // Esperamos a que termine el envio
-            __delay_ms(50);                 // Sample time para el cambio
+        MARCA(RD5, 1);
+        NUCLEO_ADC(HW_CANAL_ADC(), HW_MUESTRA_ADC());
+        // El siguiente canal adquiere mientras se espera el prximo TMR0
+        INDICE_ADC++;
+        if(INDICE_ADC >= N_CANALES){
+            INDICE_ADC = 0;
         }
+        ADCON0bits.CHS = CANALES_ADC[INDICE_ADC];
         PIR1bits.ADIF = 0;                  // Limpieza de bandera de interrupcin
+        MARCA(RD5, 0);
+    }
+    if(PIE1bits.TMR2IE && PIR1bits.TMR2IF){ // Fin de un periodo del PWM
+        PIR1bits.TMR2IF = 0;
+        NUCLEO_PERIODO_PWM();
+    }
+    if(PIR1bits.SSPIF){                     // Termin un byte (SPI) o un evento del bus (I2C)
+        DATO_SPI = SSPBUF;                  // Lectura para limpiar BF
+        PIR1bits.SSPIF = 0;                 // Limpieza de bandera del MSSP
+        SPI_SIGUIENTE();                    // Siguiente byte de la trama
     }
+#if TRANSPORTE_I2C
+    if(PIR2bits.BCLIF){                     // Colisin en el bus I2C, se abandona la trama
+        PIR2bits.BCLIF = 0;
+        I2C_COLISION();
+    }
+#endif
     if(PIR1bits.RCIF){          // Hay datos recibidos?
-        if(MODO == 2){
-            VALOR_USART = RCREG;
-            if(VALOR_USART == 0){
-                SELECCION_SERVO = 1;
-            }
-            else if(VALOR_USART == 1){
-                SELECCION_SERVO = 2;
-            }
-            else if(VALOR_USART == 2){
-                SELECCION_SERVO = 3;
+        MARCA(RD4, 1);
+        while(PIR1bits.RCIF){               // Vaciar la FIFO de 2 bytes del EUSART
+            if(RCSTAbits.FERR){             // Error de trama, el byte se descarta
+                DATO_USART = RCREG;
+                ERRORES_FERR++;
             }
-            else if(VALOR_USART == 3){
-                SELECCION_SERVO = 4;
-            }
-            else if(VALOR_USART > 3){
-                if(SELECCION_SERVO == 1){
-                     POT_1_E = VALOR_USART;
-                }
-                else if(SELECCION_SERVO == 2){
-                     POT_2_E = VALOR_USART;
-                }
-                else if(SELECCION_SERVO == 3){
-                     POT_3_E = VALOR_USART;
+            else{
+                DATO_USART = RCREG;
+                if(((RX_FIN + 1) & RX_MASK) == RX_INICIO){
+                    ERRORES_RX++;           // Buffer lleno
                 }
-                else if(SELECCION_SERVO == 4){
-                     POT_4_E = VALOR_USART;
+                else{
+                    RX_BUFFER[RX_FIN] = DATO_USART;
+                    RX_FIN = (RX_FIN + 1) & RX_MASK;
                 }
             }
-           
         }
-        
-        
+        if(RCSTAbits.OERR){                 // Desbordamiento: la FIFO ya se guard
+            RCSTAbits.CREN = 0;             // Reinicio del receptor para limpiar OERR
+            RCSTAbits.CREN = 1;
+            ERRORES_OERR++;
+        }
+        MARCA(RD4, 0);
+    }
+    if(PIR2bits.EEIF){                      // Termin un byte de la EEPROM o main encol el primero
+        PIR2bits.EEIF = 0;                  // Limpieza de bandera de escritura
+        EECON1bits.WREN = 0;                // Deshabilitar escritura en la EEPROM
+        EEPROM_SIGUIENTE();                 // Iniciar la siguiente escritura de la cola
+    }
+    if(PIE1bits.TXIE && PIR1bits.TXIF){     // TXREG libre y hay datos por enviar
+        if(TX_INICIO != TX_FIN){
+            TXREG = TX_BUFFER[TX_INICIO];   // Siguiente byte del buffer
+            TX_INICIO = (TX_INICIO + 1) & TX_MASK;
+        }
+        else{
+            PIE1bits.TXIE = 0;              // Buffer vaco, se detiene la interrupcin
+        }
     }
+    MARCA(RD7, 0);
     return;
 }
 
@@ -252,102 +202,9 @@ void __interrupt() isr (void){
  ------------------------------------------------------------------------------*/
 void main(void) {
     setup();
+    NUCLEO_INICIAR();                       // Poses, modo y posicin guardados
     while(1){
-        if (ADCON0bits.GO == 0){
-            if(ADCON0bits.CHS == 0){        // Interrupcin por AN0
-                ADCON0bits.CHS = 1;         // Cambio de AN0 a AN1
-            }
-            else if (ADCON0bits.CHS == 1){  // Interrupcin por AN1
-                ADCON0bits.CHS = 2;         // Cambio de AN1 a AN0         
-            }
-            else if (ADCON0bits.CHS == 2){  // Interrupcin por AN1
-                ADCON0bits.CHS = 3;         // Cambio de AN1 a AN0         
-            }
-            else if (ADCON0bits.CHS == 3){  // Interrupcin por AN1
-                ADCON0bits.CHS = 0;         // Cambio de AN1 a AN0         
-            }
-             __delay_us(40);                // Sample time era de 10 ms
-            ADCON0bits.GO = 1;              // On
-        }
-        
-        if(CONT > 4){
-            CONT  = 0;
-            BANDERA_R = 0;
-        }
-        
-        if(CONT3 > 4){
-            CONT3  = 0;
-            BANDERA_MODO2A0 = 0;
-        }
-        
-        if (MODO == 0){
-            if (BANDERA_E1 == 1){
-                ESCRITURA_EEPROM(1, POT_1);
-                __delay_ms(1);
-                ESCRITURA_EEPROM(2, POT_2);
-                __delay_ms(1);
-                ESCRITURA_EEPROM(3, POT_3);
-                __delay_ms(1);
-                ESCRITURA_EEPROM(4, POT_4);
-                __delay_ms(1);
-                
-                BANDERA_E1 = 0;
-            }
-            if(BANDERA_E2 == 1){
-                ESCRITURA_EEPROM(5, POT_1);
-                __delay_ms(1);
-                ESCRITURA_EEPROM(6, POT_2);
-                __delay_ms(1);
-                ESCRITURA_EEPROM(7, POT_3);
-                __delay_ms(1);
-                ESCRITURA_EEPROM(8, POT_4);
-                __delay_ms(1);
-                
-                BANDERA_E2 = 0;
-            }
-            PORTEbits.RE0 = 1;
-            PORTEbits.RE1 = 0;
-            PORTEbits.RE2 = 0;
-        }
-        else if (MODO == 1){
-            if (BANDERA_L1 == 1){
-                
-                POT_1 = LECTURA_EEPROM(1);
-                __delay_ms(1);          // <-------------- PROBAR DELAY DE 1000 a 5000 ms
-                POT_2 = LECTURA_EEPROM(2);
-                __delay_ms(1);          // <-------------- PROBAR DELAY DE 1000 a 5000 ms
-                POT_3 = LECTURA_EEPROM(3);
-                __delay_ms(1);          // <-------------- PROBAR DELAY DE 1000 a 5000 ms
-                POT_4 = LECTURA_EEPROM(4);
-                __delay_ms(1);          // <-------------- PROBAR DELAY DE 1000 a 5000 ms
-                
-                BANDERA_R = 1;
-                        
-                BANDERA_L1 = 0;
-            }
-            if (BANDERA_L2 == 1){
-                POT_1 = LECTURA_EEPROM(5);
-                __delay_ms(1);          // <-------------- PROBAR DELAY DE 1000 a 5000 ms
-                POT_2 = LECTURA_EEPROM(6);
-                __delay_ms(1);          // <-------------- PROBAR DELAY DE 1000 a 5000 ms
-                POT_3 = LECTURA_EEPROM(7);
-                __delay_ms(1);          // <-------------- PROBAR DELAY DE 1000 a 5000 ms
-                POT_4 = LECTURA_EEPROM(8);
-                __delay_ms(1);          // <-------------- PROBAR DELAY DE 1000 a 5000 ms
-                
-                BANDERA_R = 1;
-                
-                BANDERA_L2 = 0;
-            }
-            PORTEbits.RE0 = 0;
-            PORTEbits.RE1 = 1;
-            PORTEbits.RE2 = 0;  
-        }
-        else if (MODO == 2){
-            PORTEbits.RE0 = 0;
-            PORTEbits.RE1 = 0;
-            PORTEbits.RE2 = 1;
-        }
+        NUCLEO_PRINCIPAL();
     }
     return;
 }
@@ -356,6 +213,7 @@ void main(void) {
  * CONFIGURACION 
  ------------------------------------------------------------------------------*/
 void setup(void){       
+    uint8_t E;
     // Configuracin del oscilador interno
     OSCCONbits.IRCF = 0b0100;       // 1MHz
     OSCCONbits.SCS = 1;             // Reloj interno
@@ -364,11 +222,11 @@ void setup(void){
     ANSEL = 0b00001111;             // AN0 - AN3 como entrada analgicas
     ANSELH = 0b00000000;            // I/O digitales
     
-    TRISA = 0b00001111;             // AN0 - AN3 como entrada
+    TRISA = 0b00001111;             // AN0 - AN3 como entrada, RA4 (CS del ESCLAVO8) y RA5 (LATCH) como salida
     TRISB = 0b00000111;             // RB0 - RB2 como entrada
     TRISC = 0b00010000;             // SDI entrada, SCK y SD0 como salida
     
-    // RD0 y RD1 inidcan hacia cul servomotor enviar la seal
+    // RA6 es el chip-select del ESCLAVO1, RD4 - RD7 se usan con MEDIR_ISR
     TRISD = 0b00000000;             // Como salida
     // NO SE USA -> PARA PRUEBAS
     TRISE = 0b00000000;             // Como salida
@@ -378,6 +236,13 @@ void setup(void){
     PORTC = 0b00000000;             // Limpieza del PORTC
     PORTD = 0b00000000;             // Limpieza del PORTD
     PORTE = 0b00000000;             // Limpieza del PORTE
+#if CS_DECODIFICADOR
+    PORTAbits.RA6 = 1;              // Decodificador deshabilitado
+#else
+    for(E = 0; E < N_ESCLAVOS; E++){
+        HW_SPI_CS(E, 1);            // Ningn esclavo seleccionado
+    }
+#endif
     
     // Configuracin de interrucpiones
     INTCONbits.GIE = 1;             // Habilitamos interrupciones globales
@@ -392,6 +257,9 @@ void setup(void){
     
     PIE1bits.RCIE = 1;              // Habilitamos Interrupciones de recepcin
     
+    PIR2bits.EEIF = 0;              // Limpiamos bandera de escritura de EEPROM
+    PIE2bits.EEIE = 1;              // Habilitamos interrupcin de fin de escritura
+    
     // Configuracin PORTB
     OPTION_REGbits.nRBPU = 0;       // Habilitamos Pull-Ups
     WPUBbits.WPUB = 0b00000111;     // Pull-Ups en RB0 - RB2
@@ -401,13 +269,32 @@ void setup(void){
     ADCON0bits.ADCS = 0b00000010;   // FOSC/32
     ADCON1bits.VCFG0 = 0;           // VDD
     ADCON1bits.VCFG1 = 0;           // VSS
-    ADCON0bits.CHS = 0b0000;        // Seleccin de canal AN0
+    ADCON0bits.CHS = CANALES_ADC[0];    // Primer canal de la secuencia
     ADCON1bits.ADFM = 0;            // Configuracin de justificado a la izquierda
     ADCON0bits.ADON = 1;            // Habilitacin del modulo ADC
     __delay_us(1000);               // Delay de sample time
+    
+    // Configuracin TMR0 (secuenciador del ADC)
+    OPTION_REGbits.T0CS = 0;        // Reloj interno Fosc/4
+    OPTION_REGbits.PSA = 0;         // Prescaler asignado a TMR0
+    OPTION_REGbits.PS = 0b000;      // Prescaler 1:2
+    TMR0 = TMR0_CARGA;              // Carga para 2 ms
+    INTCONbits.T0IF = 0;            // Limpiar bandera de TMR0
+    INTCONbits.T0IE = 1;            // Habilitamos interrupcin de TMR0
         
-    // Configuracin de SPI    
-    // Configuracin del MAESTRO    
+#if TRANSPORTE_I2C
+    // Configuracin de I2C
+    TRISCbits.TRISC3 = 1;           // SCL y SDA como entrada, el MSSP maneja los pines
+    TRISCbits.TRISC4 = 1;
+    SSPADD = I2C_SSPADD;            // 83 kHz
+    SSPSTATbits.SMP = 1;            // Sin control de pendiente (100 kHz)
+    SSPCONbits.SSPM = 0b1000;       // I2C Maestro, Fosc/(4*(SSPADD+1))
+    SSPCONbits.SSPEN = 1;
+    PIR2bits.BCLIF = 0;
+    PIE2bits.BCLIE = 1;             // Habilitamos interrupcin de colisin en el bus
+#else
+    // Configuracin de SPI
+    // Configuracin del MAESTRO
     // SSPCON<5:0>
     SSPCONbits.SSPM = 0b0000;       // SPI Maestro, Reloj -> Fosc/4 (250kbits/s)
     SSPCONbits.CKP = 0;             // Reloj inactivo en 0
@@ -415,7 +302,9 @@ void setup(void){
     // SSPSTAT<7:6>
     SSPSTATbits.CKE = 1;            // Dato enviado cada flanco de subida
     SSPSTATbits.SMP = 1;            // Dato al final del pulso de reloj
-    SSPBUF = 0b00000000;            // Enviamos un dato inicial (valor inicial de la variable)
+#endif
+    PIR1bits.SSPIF = 0;             // Limpiamos bandera del MSSP
+    PIE1bits.SSPIE = 1;             // Habilitamos interrupcin del MSSP
     
     // Configuracin PWM
     TRISCbits.TRISC2 = 1;           // Deshabilitar salida de CCP1 (Se pone como entrada)
@@ -438,19 +327,31 @@ void setup(void){
     PIR1bits.TMR2IF = 0;            // Limpiar bandera de TMR2
     T2CONbits.T2CKPS = 0b01;        // Prescaler 1:4
     T2CONbits.TMR2ON = 1;           // Encender TMR2
+    
+    // Configuracin TMR1 (marcapasos de 50 ms)
+    T1CONbits.TMR1CS = 0;           // Reloj interno Fosc/4
+    T1CONbits.T1CKPS = 0b00;        // Prescaler 1:1
+    TMR1H = TMR1_CARGA>>8;          // Carga para 50 ms
+    TMR1L = TMR1_CARGA & 0xFF;
+    PIR1bits.TMR1IF = 0;            // Limpiar bandera de TMR1
+    PIE1bits.TMR1IE = 1;            // Habilitamos interrupcin de TMR1
+    T1CONbits.TMR1ON = 1;           // Encender TMR1
     while (!PIR1bits.TMR2IF);       // Esperar un ciclo del TMR2
     PIR1bits.TMR2IF = 0;
+#if LATCH_SIMULTANEO
+    PIE1bits.TMR2IE = 1;            // El latch se da al final de un periodo
+#endif
     
     TRISCbits.TRISC2 = 0;           // Habilitar salida de PWM
     TRISCbits.TRISC1 = 0;           // Habilitar salida de PWM
     
     // Configuracion de comunicacion serial
-    //SYNC = 0, BRGH = 1, BRG16 = 1, SPBRG=25 <- Valores de tabla 12-5
+    //SYNC = 0, BRGH = 1, BRG16 = 1, SPBRG=BAUD_SPBRG <- Valores de tabla 12-5
     TXSTAbits.SYNC = 0;         // Comunicacin ascincrona (full-duplex)
     TXSTAbits.BRGH = 1;         // Baud rate de alta velocidad 
     BAUDCTLbits.BRG16 = 1;      // 16-bits para generar el baud rate
     
-    SPBRG = 25;
+    SPBRG = BAUD_SPBRG;
     SPBRGH = 0;                 // Baud rate ~9600, error -> 0.16%
     
     RCSTAbits.SPEN = 1;         // Habilitamos comunicacin
@@ -464,34 +365,122 @@ void setup(void){
 /*------------------------------------------------------------------------------
  * FUNCIONES 
  ------------------------------------------------------------------------------*/
-unsigned short map(short x, uint8_t x0, uint8_t x1, 
-            unsigned short y0, unsigned short y1){
-    return (unsigned short)(y0+((float)(y1-y0)/(x1-x0))*(x-x0));
-}
 
 uint8_t LECTURA_EEPROM(uint8_t DIRECCION){
+    while(EEPROM_OCUPADA);          // No mover EEADR durante una escritura
     EEADR = DIRECCION;              // Cargar direccin
     EECON1bits.EEPGD = 0;           // Realizar lectura de la EEPROM
     EECON1bits.RD = 1;              // Obtencin del dato de la EEPROM
     return EEDAT;                   // Retorno del dato extrado de la EEPROM 
 }
 
+// Encola un byte para la EEPROM; las escrituras las inicia la interrupcin de
+// EEIF. Solo espera si la cola est llena. EEPROM_OCUPADA vuelve a 0 cuando
+// se terminaron todas las escrituras pendientes
 void ESCRITURA_EEPROM(uint8_t DIRECCION, uint8_t DATA){
-    EEADR = DIRECCION;              // Cargar direccin
-    EEDAT = DATA;                   // Cargar dato a escribir
+    while(((EE_FIN + 1) & EE_MASK) == EE_INICIO);   // Cola llena
+    COLA_EEPROM[EE_FIN].DIRECCION = DIRECCION;
+    COLA_EEPROM[EE_FIN].DATO = DATA;
+    EE_FIN = (EE_FIN + 1) & EE_MASK;
+    if(!EEPROM_OCUPADA){            // Sin escritura en curso: EEIF por software
+        EEPROM_OCUPADA = 1;         // arranca la cola desde isr(), as
+        PIR2bits.EEIF = 1;          // EEPROM_SIGUIENTE solo corre en la interrupcin
+    }
+}
+
+// Escribe las FLASH_BLOQUE palabras desde DIRECCION. Cada palabra se carga con
+// la secuencia 0x55/0xAA; la ltima del bloque borra y programa las cuatro a
+// la vez y el CPU se detiene ~2 ms (los CCP siguen generando el PWM)
+void FLASH_ESCRIBIR_BLOQUE(uint16_t DIRECCION, const uint16_t *PALABRAS){
+    uint8_t J, GIE_PREVIO;
+    while(EEPROM_OCUPADA);          // EEADR/EEDAT los usa tambin la EEPROM
+    for(J = 0; J < FLASH_BLOQUE; J++){
+        EEADRH = (uint8_t)((DIRECCION + J) >> 8);
+        EEADR = (uint8_t)(DIRECCION + J);
+        EEDATH = (uint8_t)(PALABRAS[J] >> 8);
+        EEDAT = (uint8_t)PALABRAS[J];
+        EECON1bits.EEPGD = 1;       // Memoria de programa
+        EECON1bits.WREN = 1;
+        GIE_PREVIO = INTCONbits.GIE;
+        INTCONbits.GIE = 0;
+        EECON2 = 0x55;
+        EECON2 = 0xAA;
+        EECON1bits.WR = 1;
+        NOP();                      // Instrucciones ignoradas durante la escritura
+        NOP();
+        if(GIE_PREVIO){
+            INTCONbits.GIE = 1;
+        }
+    }
+    EECON1bits.WREN = 0;
+}
+
+uint16_t FLASH_LEER(uint16_t DIRECCION){
+    while(EEPROM_OCUPADA);          // No mover EEADR durante una escritura
+    EEADRH = (uint8_t)(DIRECCION >> 8);
+    EEADR = (uint8_t)DIRECCION;
+    EECON1bits.EEPGD = 1;           // Memoria de programa
+    EECON1bits.RD = 1;
+    NOP();                          // El dato est listo dos ciclos despus
+    NOP();
+    return ((uint16_t)EEDATH << 8) | EEDAT;
+}
+
+#if TRANSPORTE_I2C
+// Un esclavo puede quedar reteniendo SDA a mitad de un byte tras una
+// colisin. Con el MSSP apagado se dan hasta 9 pulsos en SCL hasta que suelte
+// SDA y se genera la parada a mano (SDA sube con SCL en alto). Los pines van
+// como drenador abierto: latch en 0 y TRIS en 1 para soltar la lnea. Cada
+// instruccin dura 4 us: el NOP deja SCL en bajo 8 us (mnimo 4.7 us a
+// 100 kHz) y da 8 us entre la subida de SCL y la de SDA en la parada (mnimo
+// 4 us). Solo se llama desde isr(); al final SSPIF en 1 hace que
+// SPI_SIGUIENTE cierre la trama abandonada
+void I2C_LIBERAR(void){
+    uint8_t PULSOS = 9;
+    SSPCONbits.SSPEN = 0;
+    PORTCbits.RC3 = 0;
+    PORTCbits.RC4 = 0;
+    while(PULSOS && !PORTCbits.RC4){
+        TRISCbits.TRISC3 = 0;               // SCL en bajo
+        NOP();
+        TRISCbits.TRISC3 = 1;               // SCL sube por el pull-up
+        PULSOS--;
+    }
+    TRISCbits.TRISC3 = 0;
+    TRISCbits.TRISC4 = 0;                   // SDA en bajo con SCL en bajo
+    NOP();
+    TRISCbits.TRISC3 = 1;
+    NOP();
+    TRISCbits.TRISC4 = 1;                   // Parada: SDA sube con SCL en alto
+    SSPCONbits.SSPEN = 1;
+    PIR1bits.SSPIF = 1;
+}
+#endif
+
+// Inicia la siguiente escritura de la cola; solo se llama desde isr(), con
+// GIE ya en 0 para la secuencia 0x55/0xAA. Antes se lee el byte y si ya
+// tiene el valor se omite, sin gastar los ~5 ms ni un ciclo de la celda
+void EEPROM_SIGUIENTE(void){
+    EEPROM_OCUPADA = 1;
+    while(EE_INICIO != EE_FIN){
+        EEADR = COLA_EEPROM[EE_INICIO].DIRECCION;   // Cargar direccin
+        EECON1bits.EEPGD = 0;
+        EECON1bits.RD = 1;          // Lectura del valor actual
+        if(EEDAT != COLA_EEPROM[EE_INICIO].DATO){
+            break;
+        }
+        EE_INICIO = (EE_INICIO + 1) & EE_MASK;
+        EE_OMITIDAS++;
+    }
+    if(EE_INICIO == EE_FIN){        // Cola vaca
+        EEPROM_OCUPADA = 0;
+        return;
+    }
+    EEDAT = COLA_EEPROM[EE_INICIO].DATO;        // Cargar dato a escribir
+    EE_INICIO = (EE_INICIO + 1) & EE_MASK;
     EECON1bits.EEPGD = 0;           // Modo escritura a la EEPROM
     EECON1bits.WREN = 1;            // Habilitar escritura en la EEPROM
-    
-    INTCONbits.GIE = 0;             // Deshabilitar las interrupciones globales
     EECON2 = 0x55;      
     EECON2 = 0xAA;
-    
     EECON1bits.WR = 1;              // Iniciar escritura
-    
-    while(!PIR2bits.EEIF); //Mientras no se haya completado la escritura espera
-    PIR2bits.EEIF = 0; //Limpieza de bandera de escritura
-    
-    EECON1bits.WREN = 0;            // Deshabilitar escritura en la EEPROM
-    INTCONbits.RBIF = 0;            // Limpiar interrupciones PORTB
-    INTCONbits.GIE = 1;             // Habilitar las interrupciones globales
-}
\ No newline at end of file
+}
@@ -0,0 +1,65 @@
+/* 
+ * File:   hw.h
+ * Capa de hardware del maestro en el PIC16F887: registros detrs de las
+ * macros HW_* que usan nucleo.c e isr(). La simulacin de gcc reemplaza
+ * este archivo por simulacion/hw_sim.h
+ */
+
+#ifndef HW_H
+#define HW_H
+
+#include <xc.h>
+#include <stdint.h>
+
+#define DCB_MASK 0b00110000     // Bits DCxB dentro de CCP1CON/CCP2CON
+
+// Chip-select: 0 -> un pin por esclavo (tabla CS_PINES), 1 -> decodificador
+// 74HC138 con A0 - A2 en RD0 - RD2 y G2A en RA6 (tabla CS_DIRECCION)
+#define CS_DECODIFICADOR 0
+#if N_ESCLAVOS > 8
+#error "Hay chip-select para 8 esclavos como mximo"
+#endif
+
+/*------------------------------------------------------------------------------
+ * CAPA DE HARDWARE 
+ * Las funciones de nucleo.c y main() solo tocan los perifricos a travs de
+ * estas macros y de LECTURA_EEPROM()/ESCRITURA_EEPROM()/FLASH_*(); los
+ * registros quedan en isr(), setup() y en los manejadores de EEPROM y flash
+ ------------------------------------------------------------------------------*/
+#define HW_BOTONES()        PORTB                   // RB0 - RB2, activos en bajo
+#define HW_MUESTRA_ADC()    ADRESH                  // 8 bits, justificado a la izquierda
+#define HW_CANAL_ADC()      ADCON0bits.CHS          // Canal de la conversin terminada
+#define HW_CCP1(d)          do{ CCPR1L = (d).CCPRL; CCP1CON = (CCP1CON & ~DCB_MASK) | (d).DCB; }while(0)
+#define HW_CCP2(d)          do{ CCPR2L = (d).CCPRL; CCP2CON = (CCP2CON & ~DCB_MASK) | (d).DCB; }while(0)
+// Lnea de aplicacin comn a los esclavos. Fuera de PORTB: escribir en
+// PORTB desde isr() actualiza el latch de comparacin del interrupt-on-change
+// y se perdera un flanco de RB0 - RB2 llegado despus de revisar RBIF
+#define HW_LATCH(v)         (PORTAbits.RA5 = (v))
+#define HW_SPI_ENVIAR(v)    (SSPBUF = (v))
+#define HW_I2C_INICIO()     (SSPCON2bits.SEN = 1)
+#define HW_I2C_REINICIO()   (SSPCON2bits.RSEN = 1)
+#define HW_I2C_PARADA()     (SSPCON2bits.PEN = 1)
+#define HW_I2C_RECIBIR()    (SSPCON2bits.RCEN = 1)
+#define HW_I2C_ACK(nack)    do{ SSPCON2bits.ACKDT = (nack); SSPCON2bits.ACKEN = 1; }while(0)
+#define HW_I2C_NACK()       SSPCON2bits.ACKSTAT     // El esclavo no reconoci el byte
+#if CS_DECODIFICADOR                                // Chip-select activo en bajo
+#define HW_SPI_CS(e, nivel) do{ if(!(nivel)){ PORTD = (PORTD & 0b11111000) | CS_DIRECCION[e]; } \
+                                PORTAbits.RA6 = (nivel); }while(0)
+#else
+#define HW_SPI_CS(e, nivel) do{ if(nivel){ *CS_PINES[e].PUERTO |= CS_PINES[e].PIN; } \
+                                else{ *CS_PINES[e].PUERTO &= ~CS_PINES[e].PIN; } }while(0)
+#endif
+#define HW_TX_ACTIVAR()     (PIE1bits.TXIE = 1)     // TXIF enva lo pendiente del buffer
+#define HW_LEDS(v)          (PORTE = (v))           // RE0 - RE2 indican el modo
+
+#if CS_DECODIFICADOR
+extern const uint8_t CS_DIRECCION[8];
+#else
+struct CHIP_SELECT {
+    volatile uint8_t *PUERTO;
+    uint8_t PIN;                            // Mscara del bit dentro del puerto
+};
+extern const struct CHIP_SELECT CS_PINES[8];
+#endif
+
+#endif
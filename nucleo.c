@@ -0,0 +1,1401 @@
+/* 
+ * File:   nucleo.c
+ * Lgica de control del maestro, independiente de los registros del PIC.
+ * Con XC8 usa hw.h; con gcc y SIMULACION (make simulacion) usa los
+ * perifricos simulados de simulacion/
+ */
+
+#include <stdint.h>
+#include "nucleo.h"
+#ifdef SIMULACION
+#include "simulacion/hw_sim.h"
+#else
+#include "hw.h"
+#endif
+
+// Salida a los CCP propios: directa o retenida hasta el pulso de latch
+#if LATCH_SIMULTANEO
+#define SALIDA_CCP1(d)      (CCP_ESPERA[0] = (d))
+#define SALIDA_CCP2(d)      (CCP_ESPERA[1] = (d))
+#else
+#define SALIDA_CCP1(d)      HW_CCP1(d)
+#define SALIDA_CCP2(d)      HW_CCP2(d)
+#endif
+
+/*------------------------------------------------------------------------------
+ * VARIABLES 
+ ------------------------------------------------------------------------------*/
+uint8_t MODO = 0;                           // Variable para el cambio de modo
+uint8_t POT_1;                              // Valor de lectura del potencimetro 1 
+uint8_t POT_2;                              // Valor de lectura del potencimetro 2 
+uint8_t POT_3;                              // Valor de lectura del potencimetro 3 
+uint8_t POT_4;                              // Valor de lectura del potencimetro 4 
+uint8_t POT_1_E;                              // Valor de lectura del potencimetro 1 
+uint8_t POT_2_E;                              // Valor de lectura del potencimetro 2 
+uint8_t POT_3_E;                              // Valor de lectura del potencimetro 3 
+uint8_t POT_4_E;                              // Valor de lectura del potencimetro 4
+uint8_t BANDERA_L1, BANDERA_L2;             // Bandera de lectura
+uint8_t BANDERA_E1, BANDERA_E2;             // Bandera de escritura
+uint8_t BANDERA_R;
+uint8_t VALORPOT_USART;                     // Variable que almacena el valor del servomotor
+uint8_t TICKS;                              // Ticks de 50 ms dentro del paso actual
+uint8_t PASO;                               // Paso de reproduccin (1 s cada uno)
+uint8_t BANDERA_USART;
+uint8_t VALOR_USART;
+uint8_t BANDERA_MODO2A0;
+char VALORES[2];
+
+const struct DUTY TABLA_POT[256] = {TABLA_256(DUTY_POT)};      // Posicin -> CCP
+
+uint8_t SPI_TURNO;                          // Prximo esclavo en la ronda
+uint8_t BANDERA_LATCH;                      // La ronda sali completa, falta aplicarla
+uint8_t LATCH_ALTO;                         // La lnea LATCH qued en alto un periodo
+struct DUTY CCP_ESPERA[2];                  // CCP1/CCP2 propios hasta el latch
+uint8_t TICKS_SPI;                          // Periodos de TMR0 desde la ltima trama
+uint8_t SPI_POS[N_ESCLAVOS][CANALES_ESCLAVO];   // ltima posicin preparada por canal
+uint8_t SPI_PENDIENTE[N_ESCLAVOS];          // Canales con posicin nueva (bit por canal)
+#if N_ESCLAVOS > 1
+uint8_t EXTRA_CANAL[EXTRA_TAM];             // Canal extra menos 2 (canal de los esclavos)
+uint8_t EXTRA_POS[EXTRA_TAM];
+volatile uint8_t EXTRA_INICIO;              // Siguiente objetivo a preparar (interrupcin)
+volatile uint8_t EXTRA_FIN;                 // Siguiente lugar libre (main)
+#endif
+uint8_t SPI_TRAMA[SPI_TRAMA_MAX];           // Trama en transmisin
+uint8_t SPI_LEN;                            // Bytes de la trama
+uint8_t SPI_N;                              // Bytes ya escritos en SSPBUF
+uint8_t SPI_ESCLAVO;                        // Esclavo seleccionado
+uint8_t SPI_OCUPADO;                        // Hay una trama en transmisin
+uint8_t DATO_SPI;                           // Byte recibido por el MSSP
+uint8_t I2C_ESTADO;                         // I2C_INICIO ... I2C_PARADA
+uint8_t SPI_RESPUESTA[SPI_RESPUESTA_LEN];   // Bytes devueltos por el esclavo en la trama
+
+struct SALUD_ESCLAVO SALUD[N_ESCLAVOS];
+
+uint8_t RX_BUFFER[RX_TAM];                  // Buffer circular de recepcin USART
+volatile uint8_t RX_INICIO;                 // Siguiente byte a procesar (main)
+volatile uint8_t RX_FIN;                    // Siguiente posicin libre (interrupcin)
+uint8_t ERRORES_OERR;                       // Desbordamientos del receptor (OERR)
+uint8_t ERRORES_FERR;                       // Bytes con error de trama (FERR)
+uint8_t ERRORES_RX;                         // Bytes perdidos por buffer lleno
+uint8_t ERRORES_TRAMA;                      // Tramas descartadas (CRC o longitud)
+
+uint8_t TRAMA_ESTADO;                       // Estado del receptor (RX_SYNC ... RX_CRC)
+uint8_t TRAMA_CMD;
+uint8_t TRAMA_LEN;
+uint8_t TRAMA_N;                            // Bytes de datos recibidos
+uint8_t TRAMA_CRC;                          // CRC acumulado de la trama
+uint8_t TRAMA_DATOS[TRAMA_MAX];
+
+uint16_t VELOCIDAD[N_SERVOS];               // Avance mximo por actualizacin en Q8 (0 sin lmite)
+uint8_t ACELERACION[N_SERVOS];              // Aumento de la velocidad por actualizacin en Q8 (0 sin rampa)
+uint16_t VEL_ACTUAL[N_SERVOS];              // Velocidad de la rampa en Q8, solo en la interrupcin
+uint8_t AVANCE[N_SERVOS];                   // Fraccin acumulada del avance en Q8
+
+uint8_t TELEMETRIA_PERIODO;                 // Periodos de TMR0 (2 ms) entre tramas, 0 apagada
+uint8_t TICKS_TELEMETRIA;                   // Periodos de TMR0 desde la ltima trama
+uint8_t BANDERA_TELEMETRIA;                 // Toca enviar una trama de telemetra
+uint8_t SEC_TELEMETRIA;                     // Nmero de secuencia de la trama
+
+uint16_t TRAY_TIEMPO[TRAY_TAM];             // Instante de cada punto, periodos de TMR0
+uint8_t TRAY_POS[TRAY_TAM][N_SERVOS];
+volatile uint8_t TRAY_INICIO;               // Punto a aplicar (lo avanza el ISR)
+volatile uint8_t TRAY_FIN;                  // Lugar del prximo punto (lo avanza main)
+volatile uint8_t TRAY_DESCARTAR;            // Cambi el modo, main vaca la cola
+uint16_t TRAY_RELOJ;                        // Reloj de la trayectoria
+uint8_t TRAY_ACTIVA;                        // El reloj est corriendo
+uint8_t TRAY_VACIA;                         // Periodos de TMR0 con la cola vaca
+
+uint8_t TX_BUFFER[TX_TAM];                  // Buffer circular de transmisin USART
+volatile uint8_t TX_INICIO;                 // Siguiente byte a enviar (interrupcin)
+volatile uint8_t TX_FIN;                    // Siguiente posicin libre (main)
+uint8_t TX_MAX;                             // Mxima ocupacin alcanzada del buffer
+
+uint8_t LOG_VALOR[LOG_CLAVES][4];           // Valor vigente de cada clave del registro
+uint8_t LOG_RANURA[LOG_CLAVES];             // Ranura del valor vigente (LOG_VACIO si no hay)
+uint8_t LOG_CABEZA;                         // Siguiente ranura a escribir
+uint8_t LOG_SEC;                            // SEC del ltimo registro escrito
+uint8_t BANDERA_ESTADO;                     // Cambi el modo, guardar modo y posicin
+
+uint8_t SEC_CUENTA;                         // Registros guardados en la secuencia
+uint8_t SEC_INDICE;                         // Registro en reproduccin
+uint8_t SEC_NUEVA = 1;                      // 1 -> el prximo RB1 inicia otra secuencia
+volatile uint8_t SEC_REPRODUCIENDO;         // 1 mientras se reproduce la secuencia
+volatile uint8_t SEC_ESPERA;                // Ticks restantes en el registro actual
+volatile uint8_t SEC_TICKS;                 // Ticks desde el ltimo registro grabado
+uint8_t BANDERA_SEC_G, BANDERA_SEC_R;       // RB1 graba, RB2 reproduce/detiene
+uint8_t BANDERA_SEC_SIG;                    // Termin la permanencia del registro
+
+volatile uint8_t FLASH_ESTADO;              // FLASH_LIBRE, FLASH_GRABANDO o FLASH_REPRODUCIENDO
+uint8_t TICKS_MUESTRA;                      // Ticks desde la ltima muestra
+uint8_t BANDERA_MUESTRA;                    // Toca grabar o reproducir una muestra
+uint8_t BANDERA_FLASH_G, BANDERA_FLASH_R;   // RB1 graba/detiene, RB2 reproduce/detiene
+uint16_t FLASH_BUFFER[FLASH_BLOQUE];        // Palabras del bloque en preparacin
+uint8_t FLASH_LLENAS;                       // Palabras ocupadas de FLASH_BUFFER
+uint16_t FLASH_CUENTA;                      // Muestras de la trayectoria guardada
+uint16_t FLASH_INDICE;                      // Siguiente muestra a grabar o reproducir
+uint8_t BANDERA_CUENTA;                     // Guardar FLASH_CUENTA en el registro
+
+const uint8_t LEDS_MODO[N_MODOS] = {0b001, 0b010, 0b100, 0b111, 0b011};
+
+/*------------------------------------------------------------------------------
+ * FUNCIONES 
+ ------------------------------------------------------------------------------*/
+
+// Recorre las ranuras del registro una sola vez al arrancar: toma la SEC ms
+// nueva de cada clave y deja la cabeza despus del registro ms reciente.
+// Las poses sin registro se leen de sus direcciones anteriores
+void LOG_RECUPERAR(void){
+    uint8_t R, CLAVE, SEC, J;
+    uint8_t NUEVA = LOG_VACIO;              // Ranura del registro ms reciente
+    for(CLAVE = 0; CLAVE < LOG_CLAVES; CLAVE++){
+        LOG_RANURA[CLAVE] = LOG_VACIO;
+    }
+    for(R = 0; R < LOG_RANURAS; R++){
+        CLAVE = LECTURA_EEPROM(DIR_RANURA(R) + 1);
+        if(CLAVE >= LOG_CLAVES || !LOG_VALIDA(R)){  // Ranura vaca o daada
+            continue;
+        }
+        SEC = LECTURA_EEPROM(DIR_RANURA(R));
+        if(LOG_RANURA[CLAVE] == LOG_VACIO ||
+                MAS_NUEVA(SEC, LECTURA_EEPROM(DIR_RANURA(LOG_RANURA[CLAVE])))){
+            LOG_RANURA[CLAVE] = R;
+        }
+        if(NUEVA == LOG_VACIO || MAS_NUEVA(SEC, LOG_SEC)){
+            NUEVA = R;
+            LOG_SEC = SEC;
+        }
+    }
+    LOG_CABEZA = (NUEVA == LOG_VACIO || NUEVA + 1 >= LOG_RANURAS) ? 0 : NUEVA + 1;
+
+    for(CLAVE = 0; CLAVE < LOG_CLAVES; CLAVE++){
+        for(J = 0; J < 4; J++){
+            if(LOG_RANURA[CLAVE] != LOG_VACIO){
+                LOG_VALOR[CLAVE][J] = LECTURA_EEPROM(DIR_RANURA(LOG_RANURA[CLAVE]) + 2 + J);
+            }
+            else if(CLAVE < N_POSES){
+                LOG_VALOR[CLAVE][J] = LECTURA_EEPROM(DIR_POSE(CLAVE) + J);
+            }
+        }
+    }
+}
+
+// 1 si el CRC de la ranura coincide con su SEC, su clave y sus datos
+uint8_t LOG_VALIDA(uint8_t RANURA){
+    uint8_t J, CRC = 0;
+    for(J = 0; J < 6; J++){
+        CRC = CRC8(CRC, LECTURA_EEPROM(DIR_RANURA(RANURA) + J));
+    }
+    return CRC == LECTURA_EEPROM(DIR_RANURA(RANURA) + 6);
+}
+
+// Clave cuyo valor vigente est en la ranura, LOG_VACIO si la ranura est libre
+uint8_t LOG_VIGENTE(uint8_t RANURA){
+    uint8_t K;
+    for(K = 0; K < LOG_CLAVES; K++){
+        if(LOG_RANURA[K] == RANURA){
+            return K;
+        }
+    }
+    return LOG_VACIO;
+}
+
+// Agrega un registro con el nuevo valor de CLAVE. Si no cambi no se escribe
+// nada. Nunca se pisa una ranura con el valor vigente de una clave, tampoco
+// el de la propia CLAVE: la cabeza la salta y esa clave se copia en la
+// siguiente ranura libre (compactacin), as ningn registro vigente queda a
+// ms de una vuelta de la cabeza. Cada registro se escribe con su SEC al
+// final; el CRC la incluye, as que hasta ese ltimo byte la ranura no es
+// vlida y si se corta la energa sigue valiendo el registro anterior
+void LOG_ESCRIBIR(uint8_t CLAVE, const uint8_t *DATOS){
+    uint8_t J, K, DIRECCION, CRC;
+    uint8_t MOVER;                          // Claves por escribir (bit por clave)
+    if(LOG_RANURA[CLAVE] != LOG_VACIO && LOG_VALOR[CLAVE][0] == DATOS[0] &&
+            LOG_VALOR[CLAVE][1] == DATOS[1] && LOG_VALOR[CLAVE][2] == DATOS[2] &&
+            LOG_VALOR[CLAVE][3] == DATOS[3]){
+        return;
+    }
+    for(J = 0; J < 4; J++){
+        LOG_VALOR[CLAVE][J] = DATOS[J];
+    }
+    MOVER = 1 << CLAVE;
+    while(MOVER){
+        K = LOG_VIGENTE(LOG_CABEZA);
+        if(K == LOG_VACIO){                 // Ranura libre: la primera clave pendiente
+            for(K = 0; !(MOVER & (1 << K)); K++);
+            MOVER &= ~(1 << K);
+            LOG_SEC++;
+            DIRECCION = DIR_RANURA(LOG_CABEZA);
+            ESCRITURA_EEPROM(DIRECCION + 1, K);
+            CRC = CRC8(CRC8(0, LOG_SEC), K);
+            for(J = 0; J < 4; J++){
+                ESCRITURA_EEPROM(DIRECCION + 2 + J, LOG_VALOR[K][J]);
+                CRC = CRC8(CRC, LOG_VALOR[K][J]);
+            }
+            ESCRITURA_EEPROM(DIRECCION + 6, CRC);
+            ESCRITURA_EEPROM(DIRECCION, LOG_SEC);   // Confirma el registro
+            LOG_RANURA[K] = LOG_CABEZA;
+        }
+        else{                               // Ranura vigente: su clave se copia ms adelante
+            MOVER |= 1 << K;
+        }
+        LOG_CABEZA = (LOG_CABEZA + 1 >= LOG_RANURAS) ? 0 : LOG_CABEZA + 1;
+    }
+}
+
+// Guarda la posicin actual en la pose N: la copia en RAM se actualiza de
+// inmediato y la EEPROM en segundo plano
+void GUARDAR_POSE(uint8_t N){
+    uint8_t POSE[4];
+    POSE[0] = POT_1;
+    POSE[1] = POT_2;
+    POSE[2] = POT_3;
+    POSE[3] = POT_4;
+    LOG_ESCRIBIR(CLAVE_POSE(N), POSE);
+}
+
+// Carga la pose N desde RAM, sin acceder a la EEPROM
+void CARGAR_POSE(uint8_t N){
+    POT_1 = LOG_VALOR[CLAVE_POSE(N)][0];
+    POT_2 = LOG_VALOR[CLAVE_POSE(N)][1];
+    POT_3 = LOG_VALOR[CLAVE_POSE(N)][2];
+    POT_4 = LOG_VALOR[CLAVE_POSE(N)][3];
+}
+
+// Guarda el modo y la posicin actual para recuperarlos al arrancar
+void GUARDAR_ESTADO(void){
+    uint8_t DATOS[4];
+    DATOS[0] = POT_1;
+    DATOS[1] = POT_2;
+    DATOS[2] = POT_3;
+    DATOS[3] = POT_4;
+    LOG_ESCRIBIR(CLAVE_ULTIMA, DATOS);
+    DATOS[0] = MODO;
+    DATOS[1] = 0;
+    DATOS[2] = 0;
+    DATOS[3] = 0;
+    LOG_ESCRIBIR(CLAVE_MODO, DATOS);
+}
+
+// Lee la cabecera de la secuencia; sin la marca se considera vaca
+void LEER_SECUENCIA(void){
+    SEC_CUENTA = 0;
+    if(LECTURA_EEPROM(SEC_BASE) == SEC_MAGICO){
+        SEC_CUENTA = LECTURA_EEPROM(SEC_BASE + 1);
+        if(SEC_CUENTA > SEC_MAX){
+            SEC_CUENTA = SEC_MAX;
+        }
+    }
+}
+
+// Agrega la posicin actual al final de la secuencia. El tiempo desde el
+// registro anterior se guarda como la permanencia de ese registro, as la
+// reproduccin respeta el ritmo con el que se grab
+void GRABAR_REGISTRO(void){
+    uint8_t DIRECCION, J, CRC;
+    if(SEC_NUEVA == 1){                     // Primer registro desde que se entr al MODO 3
+        SEC_NUEVA = 0;
+        SEC_CUENTA = 0;
+        ESCRITURA_EEPROM(SEC_BASE, SEC_MAGICO);
+    }
+    else if(SEC_CUENTA > 0){                // Permanencia del anterior y su nuevo CRC
+        DIRECCION = DIR_REGISTRO(SEC_CUENTA - 1);
+        CRC = 0;
+        for(J = 0; J < 4; J++){
+            CRC = CRC8(CRC, LECTURA_EEPROM(DIRECCION + J));
+        }
+        ESCRITURA_EEPROM(DIRECCION + 4, SEC_TICKS);
+        ESCRITURA_EEPROM(DIRECCION + 5, CRC8(CRC, SEC_TICKS));
+    }
+    SEC_TICKS = 0;
+    if(SEC_CUENTA >= SEC_MAX){              // Secuencia llena
+        return;
+    }
+    DIRECCION = DIR_REGISTRO(SEC_CUENTA);
+    ESCRITURA_EEPROM(DIRECCION, POT_1);
+    ESCRITURA_EEPROM(DIRECCION + 1, POT_2);
+    ESCRITURA_EEPROM(DIRECCION + 2, POT_3);
+    ESCRITURA_EEPROM(DIRECCION + 3, POT_4);
+    ESCRITURA_EEPROM(DIRECCION + 4, SEC_ESPERA_FINAL);
+    CRC = CRC8(CRC8(CRC8(CRC8(CRC8(0, POT_1), POT_2), POT_3), POT_4), SEC_ESPERA_FINAL);
+    ESCRITURA_EEPROM(DIRECCION + 5, CRC);
+    SEC_CUENTA++;
+    ESCRITURA_EEPROM(SEC_BASE + 1, SEC_CUENTA);
+}
+
+// Carga el registro I como posicin actual y su tiempo de permanencia. Un
+// registro con CRC incorrecto no mueve el brazo y se salta en el siguiente tick
+uint8_t CARGAR_REGISTRO(uint8_t I){
+    uint8_t REGISTRO[SEC_TAM_REG];
+    uint8_t J, CRC = 0;
+    for(J = 0; J < SEC_TAM_REG; J++){
+        REGISTRO[J] = LECTURA_EEPROM(DIR_REGISTRO(I) + J);
+    }
+    for(J = 0; J < SEC_TAM_REG - 1; J++){
+        CRC = CRC8(CRC, REGISTRO[J]);
+    }
+    if(CRC != REGISTRO[SEC_TAM_REG - 1]){
+        SEC_ESPERA = 0;
+        return 0;
+    }
+    POT_1 = REGISTRO[0];
+    POT_2 = REGISTRO[1];
+    POT_3 = REGISTRO[2];
+    POT_4 = REGISTRO[3];
+    SEC_ESPERA = REGISTRO[4];
+    return 1;
+}
+
+uint8_t CRC8(uint8_t CRC, uint8_t DATO){
+    uint8_t I;
+    CRC ^= DATO;
+    for(I = 0; I < 8; I++){
+        if(CRC & 0x80){
+            CRC = (uint8_t)(CRC << 1) ^ CRC8_POLI;
+        }
+        else{
+            CRC = (uint8_t)(CRC << 1);
+        }
+    }
+    return CRC;
+}
+
+// Receptor de tramas: consume los bytes pendientes del buffer de recepcin y
+// ejecuta cada trama con CRC correcto. Ante un error se vuelve a buscar el
+// byte de sincrona
+void PROCESAR_USART(void){
+    if(TRAY_DESCARTAR){
+        // Solo main escribe TRAY_FIN: si el ISR vaciara la cola a mitad de
+        // ENCOLAR_PUNTO quedara un punto a medio escribir, o el descartado
+        // volvera a aparecer al avanzar TRAY_FIN
+        TRAY_DESCARTAR = 0;
+        TRAY_FIN = TRAY_INICIO;
+    }
+    while(RX_INICIO != RX_FIN){
+        VALOR_USART = RX_BUFFER[RX_INICIO];
+        RX_INICIO = (RX_INICIO + 1) & RX_MASK;
+        switch(TRAMA_ESTADO){
+            case RX_SYNC:
+                if(INICIAR_TRAMA(VALOR_USART)){
+                    EJECUTAR_POLOLU();
+                }
+                break;
+            case RX_POLOLU:
+                if((VALOR_USART & 0x80) && TRAMA_CMD != MINI_SSC){
+                    ERRORES_TRAMA++;        // Comando incompleto, el byte inicia otro
+                    TRAMA_ESTADO = RX_SYNC;
+                    if(INICIAR_TRAMA(VALOR_USART)){
+                        EJECUTAR_POLOLU();
+                    }
+                    break;
+                }
+                TRAMA_DATOS[TRAMA_N++] = VALOR_USART;
+                if(TRAMA_N >= TRAMA_LEN){
+                    EJECUTAR_POLOLU();
+                    TRAMA_ESTADO = RX_SYNC;
+                }
+                break;
+            case RX_CMD:
+                TRAMA_CMD = VALOR_USART;
+                TRAMA_CRC = CRC8(0, VALOR_USART);
+                TRAMA_ESTADO = RX_LEN;
+                break;
+            case RX_LEN:
+                TRAMA_LEN = VALOR_USART;
+                TRAMA_CRC = CRC8(TRAMA_CRC, VALOR_USART);
+                TRAMA_N = 0;
+                if(TRAMA_LEN > TRAMA_MAX){  // No cabe, se descarta la trama
+                    ERRORES_TRAMA++;
+                    TRAMA_ESTADO = RX_SYNC;
+                }
+                else{
+                    TRAMA_ESTADO = (TRAMA_LEN == 0) ? RX_CRC : RX_DATOS;
+                }
+                break;
+            case RX_DATOS:
+                TRAMA_DATOS[TRAMA_N++] = VALOR_USART;
+                TRAMA_CRC = CRC8(TRAMA_CRC, VALOR_USART);
+                if(TRAMA_N >= TRAMA_LEN){
+                    TRAMA_ESTADO = RX_CRC;
+                }
+                break;
+            default:                        // RX_CRC
+                if(VALOR_USART == TRAMA_CRC){
+                    EJECUTAR_TRAMA();
+                }
+                else{
+                    ERRORES_TRAMA++;
+                }
+                TRAMA_ESTADO = RX_SYNC;
+                break;
+        }
+    }
+}
+
+// Guarda el punto de la trama en la cola de trayectoria
+uint8_t ENCOLAR_PUNTO(void){
+    uint8_t SIGUIENTE = (TRAY_FIN + 1) & TRAY_MASK;
+    if(MODO != 2){
+        return ESTADO_MODO;
+    }
+    if(SIGUIENTE == TRAY_INICIO){
+        return ESTADO_LLENO;
+    }
+    TRAY_TIEMPO[TRAY_FIN] = TRAMA_DATOS[0] | ((uint16_t)TRAMA_DATOS[1] << 8);
+    TRAY_POS[TRAY_FIN][0] = TRAMA_DATOS[2];
+    TRAY_POS[TRAY_FIN][1] = TRAMA_DATOS[3];
+    TRAY_POS[TRAY_FIN][2] = TRAMA_DATOS[4];
+    TRAY_POS[TRAY_FIN][3] = TRAMA_DATOS[5];
+    TRAY_FIN = SIGUIENTE;                   // El punto queda visible para el ISR completo
+    return ESTADO_OK;
+}
+
+uint8_t TRAY_LIBRES(void){
+    return TRAY_MASK - ((TRAY_FIN - TRAY_INICIO) & TRAY_MASK);
+}
+
+// Trama de telemetra; si no cabe en el buffer de transmisin se pierde y el
+// receptor lo nota por el salto en el nmero de secuencia
+void ENVIAR_TELEMETRIA(void){
+    uint8_t DATOS[TELEMETRIA_LEN];
+    DATOS[0] = SEC_TELEMETRIA++;
+    DATOS[1] = MODO;
+    DATOS[2] = POT_1;
+    DATOS[3] = POT_2;
+    DATOS[4] = POT_3;
+    DATOS[5] = POT_4;
+    DATOS[6] = ERRORES_OERR;
+    DATOS[7] = ERRORES_FERR;
+    DATOS[8] = ERRORES_RX;
+    DATOS[9] = ERRORES_TRAMA;
+    ENVIAR_TRAMA(TRAMA_TELEMETRIA, DATOS, TELEMETRIA_LEN);
+}
+
+// Primer byte de un comando: sincrona de trama propia, comando Pololu o
+// Mini-SSC. Devuelve 1 si el comando no lleva datos y ya se puede ejecutar;
+// PROCESAR_USART llama a EJECUTAR_POLOLU, as no suma un nivel de pila
+uint8_t INICIAR_TRAMA(uint8_t DATO){
+    TRAMA_CMD = DATO;
+    TRAMA_N = 0;
+    if(DATO == TRAMA_SYNC){
+        TRAMA_ESTADO = RX_CMD;
+        return 0;
+    }
+    if(DATO == POLOLU_OBJETIVO || DATO == POLOLU_VELOCIDAD || DATO == POLOLU_ACELERACION){
+        TRAMA_LEN = 3;
+    }
+    else if(DATO == POLOLU_POSICION){
+        TRAMA_LEN = 1;
+    }
+    else if(DATO == MINI_SSC){
+        TRAMA_LEN = 2;
+    }
+    else if(DATO == POLOLU_MOVIMIENTO){     // Sin datos, se contesta de inmediato
+        TRAMA_LEN = 0;
+        return 1;
+    }
+    else{
+        return 0;                           // Byte fuera de un comando, se ignora
+    }
+    TRAMA_ESTADO = RX_POLOLU;
+    return 0;
+}
+
+// Ejecuta un comando Pololu/Mini-SSC. Como en las tramas propias, los
+// objetivos solo se aceptan en MODO 2; las consultas se contestan siempre
+void EJECUTAR_POLOLU(void){
+    uint8_t CANAL = TRAMA_DATOS[0];
+    uint16_t VALOR = TRAMA_DATOS[1] | ((uint16_t)TRAMA_DATOS[2] << 7);
+    uint8_t RESPUESTA[2];
+    uint8_t DUTY;
+    if(TRAMA_CMD == POLOLU_MOVIMIENTO){
+        RESPUESTA[0] = EN_MOVIMIENTO();
+        uart_write(RESPUESTA, 1);
+        return;
+    }
+    if(CANAL >= N_SALIDAS){
+        return;
+    }
+    if(TRAMA_CMD == POLOLU_POSICION){       // Posicin actual en cuartos de us
+        VALOR = ((uint16_t)TABLA_POT[POSICION_ACTUAL(CANAL)].CCPRL << 2) |
+                (TABLA_POT[POSICION_ACTUAL(CANAL)].DCB >> 4);
+        VALOR *= CUARTOS_US;
+        RESPUESTA[0] = (uint8_t)VALOR;
+        RESPUESTA[1] = (uint8_t)(VALOR >> 8);
+        uart_write(RESPUESTA, 2);
+    }
+    else if(TRAMA_CMD == POLOLU_VELOCIDAD){
+        if(CANAL >= N_SERVOS){              // Los canales extra de los esclavos no limitan velocidad
+            return;
+        }
+        VALOR = (VALOR > 4468) ? 0x7FFF : (uint16_t)VEL_Q8(VALOR);  // Tope para no desbordar AVANCE
+        di();
+        VELOCIDAD[CANAL] = VALOR;
+        ei();
+    }
+    else if(TRAMA_CMD == POLOLU_ACELERACION){
+        if(CANAL >= N_SERVOS){              // Tampoco aceleracin
+            return;
+        }
+        ACELERACION[CANAL] = ACEL_Q8((VALOR > 255) ? 255 : VALOR);  // Un byte, la interrupcin lo lee sin di()
+    }
+    else if(MODO != 2){
+        return;
+    }
+    else if(TRAMA_CMD == MINI_SSC){         // 0 - 254 -> 0 - 255
+        if(TRAMA_DATOS[1] <= 254){
+            FIJAR_OBJETIVO(CANAL, (uint8_t)(((uint16_t)TRAMA_DATOS[1]*255 + 127)/254));
+        }
+    }
+    else if(TRAMA_CMD == POLOLU_OBJETIVO && VALOR != 0){   // 0 (apagar) no se soporta
+        VALOR /= CUARTOS_US;                // Cuentas del CCP
+        if(VALOR <= OUT_MIN1){
+            DUTY = 0;
+        }
+        else if(VALOR >= OUT_MAX1){
+            DUTY = 255;
+        }
+        else{
+            DUTY = (uint8_t)(((uint32_t)(VALOR - OUT_MIN1)*PEND_INV) >> MAP_Q);
+        }
+        FIJAR_OBJETIVO(CANAL, DUTY);
+    }
+}
+
+void FIJAR_OBJETIVO(uint8_t CANAL, uint8_t POSICION){
+    if(CANAL == 0){
+        POT_1_E = POSICION;
+    }
+    else if(CANAL == 1){
+        POT_2_E = POSICION;
+    }
+    else if(CANAL == 2){
+        POT_3_E = POSICION;
+    }
+    else if(CANAL == 3){
+        POT_4_E = POSICION;
+    }
+#if N_ESCLAVOS > 1
+    else if(((EXTRA_FIN + 1) & EXTRA_MASK) != EXTRA_INICIO){
+        // Canal extra: la interrupcin lo pasa a la trama del esclavo en el
+        // siguiente periodo de TMR0. A 9600 baudios no llegan EXTRA_TAM
+        // comandos en 2 ms, as que la cola no se llena
+        EXTRA_CANAL[EXTRA_FIN] = CANAL - 2;
+        EXTRA_POS[EXTRA_FIN] = POSICION;
+        EXTRA_FIN = (EXTRA_FIN + 1) & EXTRA_MASK;
+    }
+#endif
+}
+
+uint8_t POSICION_ACTUAL(uint8_t CANAL){
+    if(CANAL == 0){
+        return POT_1;
+    }
+    else if(CANAL == 1){
+        return POT_2;
+    }
+    else if(CANAL == 2){
+        return POT_3;
+    }
+    else if(CANAL == 3){
+        return POT_4;
+    }
+    return SPI_POS[(CANAL - 2) / CANALES_ESCLAVO][(CANAL - 2) % CANALES_ESCLAVO];
+}
+
+// 1 si en MODO 2 alguna articulacin todava se dirige a su objetivo
+uint8_t EN_MOVIMIENTO(void){
+    return MODO == 2 && (POT_1 != POT_1_E || POT_2 != POT_2_E ||
+            POT_3 != POT_3_E || POT_4 != POT_4_E);
+}
+
+// Ejecuta la trama recibida y enva la respuesta
+void EJECUTAR_TRAMA(void){
+    uint8_t ESTADO = ESTADO_OK;
+    if(TRAMA_CMD == CMD_CONSULTA && TRAMA_LEN == 0){
+        TRAMA_DATOS[0] = POT_1;
+        TRAMA_DATOS[1] = POT_2;
+        TRAMA_DATOS[2] = POT_3;
+        TRAMA_DATOS[3] = POT_4;
+        ENVIAR_TRAMA(CMD_CONSULTA | CMD_RESPUESTA, TRAMA_DATOS, 4);
+        return;
+    }
+    if(TRAMA_CMD == CMD_ESCLAVO && TRAMA_LEN == 1 && TRAMA_DATOS[0] < N_ESCLAVOS){
+        struct SALUD_ESCLAVO *S = &SALUD[TRAMA_DATOS[0]];
+        uint8_t J;
+        di();
+        TRAMA_DATOS[0] = S->FALLOS;
+        TRAMA_DATOS[1] = S->ERRORES;
+        TRAMA_DATOS[2] = S->PERDIDAS;
+        TRAMA_DATOS[3] = S->RETRASO;
+        TRAMA_DATOS[4] = S->RETRASO_MAX;
+        TRAMA_DATOS[5] = S->TRAMAS;
+        for(J = 0; J < CANALES_ESCLAVO; J++){
+            TRAMA_DATOS[6 + J] = S->POS[J];
+        }
+        ei();
+        ENVIAR_TRAMA(CMD_ESCLAVO | CMD_RESPUESTA, TRAMA_DATOS, 6 + CANALES_ESCLAVO);
+        return;
+    }
+    if(TRAMA_CMD == CMD_TRAYECTORIA && (TRAMA_LEN == 0 || TRAMA_LEN == 6)){
+        if(TRAMA_LEN == 6){                 // Sin datos solo se consultan los crditos
+            ESTADO = ENCOLAR_PUNTO();
+        }
+        TRAMA_DATOS[0] = ESTADO;
+        TRAMA_DATOS[1] = TRAY_LIBRES();
+        ENVIAR_TRAMA(CMD_TRAYECTORIA | CMD_RESPUESTA, TRAMA_DATOS, 2);
+        return;
+    }
+    if(TRAMA_CMD == CMD_POSICION && TRAMA_LEN == 2 && TRAMA_DATOS[0] < N_SALIDAS){
+        if(MODO != 2){
+            ESTADO = ESTADO_MODO;
+        }
+        else{
+            FIJAR_OBJETIVO(TRAMA_DATOS[0], TRAMA_DATOS[1]);
+        }
+    }
+    else if(TRAMA_CMD == CMD_TELEMETRIA && TRAMA_LEN == 1){
+        di();
+        TELEMETRIA_PERIODO = TRAMA_DATOS[0];
+        TICKS_TELEMETRIA = 0;
+        ei();
+    }
+    else if(TRAMA_CMD == CMD_POSICIONES && TRAMA_LEN == 4){
+        if(MODO != 2){
+            ESTADO = ESTADO_MODO;
+        }
+        else{                               // Las cuatro articulaciones en la misma trama
+            POT_1_E = TRAMA_DATOS[0];
+            POT_2_E = TRAMA_DATOS[1];
+            POT_3_E = TRAMA_DATOS[2];
+            POT_4_E = TRAMA_DATOS[3];
+        }
+    }
+    else{
+        ESTADO = ESTADO_INVALIDO;
+    }
+    ENVIAR_TRAMA(TRAMA_CMD | CMD_RESPUESTA, &ESTADO, 1);
+}
+
+// Enva una trama completa o nada: si no cabe en el buffer de transmisin se
+// descarta para no dejar tramas cortadas. Retorna 1 si se encol. Escribe
+// directo en TX_BUFFER, sin uart_write ni CRC8, porque EJECUTAR_TRAMA la
+// llama desde el nivel ms profundo de NUCLEO_PRINCIPAL
+uint8_t ENVIAR_TRAMA(uint8_t CMD, const uint8_t *DATOS, uint8_t LEN){
+    uint8_t J, I, BYTE, OCUPADOS;
+    uint8_t CRC = 0;
+    if(LEN > TRAMA_MAX || TX_MASK - ((TX_FIN - TX_INICIO) & TX_MASK) < LEN + 4){
+        return 0;
+    }
+    TX_BUFFER[TX_FIN] = TRAMA_SYNC;
+    TX_FIN = (TX_FIN + 1) & TX_MASK;
+    for(J = 0; J < LEN + 3; J++){           // CMD, LEN, DATOS y el CRC
+        if(J == 0){
+            BYTE = CMD;
+        }
+        else if(J == 1){
+            BYTE = LEN;
+        }
+        else if(J < LEN + 2){
+            BYTE = DATOS[J - 2];
+        }
+        else{
+            BYTE = CRC;
+        }
+        TX_BUFFER[TX_FIN] = BYTE;
+        TX_FIN = (TX_FIN + 1) & TX_MASK;
+        CRC ^= BYTE;                        // El mismo clculo de CRC8()
+        for(I = 0; I < 8; I++){
+            if(CRC & 0x80){
+                CRC = (uint8_t)(CRC << 1) ^ CRC8_POLI;
+            }
+            else{
+                CRC = (uint8_t)(CRC << 1);
+            }
+        }
+    }
+    OCUPADOS = (TX_FIN - TX_INICIO) & TX_MASK;
+    if(OCUPADOS > TX_MAX){                  // Estadstica de mxima ocupacin
+        TX_MAX = OCUPADOS;
+    }
+    HW_TX_ACTIVAR();                        // La interrupcin de TXIF enva lo pendiente
+    return 1;
+}
+
+// Copia hasta N bytes al buffer de transmisin sin esperar al EUSART.
+// Retorna cuntos bytes se aceptaron (menos de N si el buffer se llen)
+uint8_t uart_write(const uint8_t *DATOS, uint8_t N){
+    uint8_t ESCRITOS = 0;
+    uint8_t SIGUIENTE;
+    uint8_t OCUPADOS;
+    while(ESCRITOS < N){
+        SIGUIENTE = (TX_FIN + 1) & TX_MASK;
+        if(SIGUIENTE == TX_INICIO){ // Buffer lleno
+            break;
+        }
+        TX_BUFFER[TX_FIN] = DATOS[ESCRITOS];
+        TX_FIN = SIGUIENTE;
+        ESCRITOS++;
+    }
+    OCUPADOS = (TX_FIN - TX_INICIO) & TX_MASK;
+    if(OCUPADOS > TX_MAX){          // Estadstica de mxima ocupacin
+        TX_MAX = OCUPADOS;
+    }
+    HW_TX_ACTIVAR();                // La interrupcin de TXIF enva lo pendiente
+    return ESCRITOS;
+}
+
+// Deja la posicin de un canal del esclavo para la prxima trama; solo se usa
+// desde la interrupcin
+void SPI_PREPARAR(uint8_t ESCLAVO, uint8_t CANAL, uint8_t VALOR){
+    SPI_POS[ESCLAVO][CANAL] = VALOR;
+    SPI_PENDIENTE[ESCLAVO] |= 1 << CANAL;
+}
+
+// Si el bus est libre, arma la trama del esclavo con sus canales pendientes
+// y enva la cabecera; SPI_SIGUIENTE manda el resto. Sin canales pendientes
+// la trama va con MASCARA 0 y solo sirve para leer el estado del esclavo.
+// Retorna 0 si el bus segua ocupado con la trama anterior
+uint8_t SPI_TRANSMITIR(uint8_t ESCLAVO){
+    uint8_t CANAL, SUMA;
+    if(SPI_OCUPADO){
+        return 0;
+    }
+    SPI_ESCLAVO = ESCLAVO;
+    SPI_TRAMA[0] = SPI_CABECERA;
+    SPI_TRAMA[1] = SPI_PENDIENTE[SPI_ESCLAVO];
+#if LATCH_SIMULTANEO
+    SPI_TRAMA[1] |= MASCARA_LATCH;
+#endif
+    SUMA = SPI_TRAMA[1];
+    SPI_LEN = 2;
+    for(CANAL = 0; CANAL < CANALES_ESCLAVO; CANAL++){
+        if(SPI_PENDIENTE[SPI_ESCLAVO] & (1 << CANAL)){
+            SPI_TRAMA[SPI_LEN++] = SPI_POS[SPI_ESCLAVO][CANAL];
+            SUMA += SPI_POS[SPI_ESCLAVO][CANAL];
+        }
+    }
+    SPI_TRAMA[SPI_LEN++] = -SUMA;
+    SPI_PENDIENTE[SPI_ESCLAVO] = 0;
+    SPI_OCUPADO = 1;
+    SPI_N = 1;                              // En I2C la cabecera no se enva
+#if TRANSPORTE_I2C
+    I2C_ESTADO = I2C_INICIO;
+    HW_I2C_INICIO();
+#else
+    while(SPI_LEN < SPI_RESPUESTA_LEN){     // Relleno para recibir la respuesta completa
+        SPI_TRAMA[SPI_LEN++] = 0;
+    }
+    HW_SPI_CS(SPI_ESCLAVO, 0);
+    HW_SPI_ENVIAR(SPI_TRAMA[0]);
+#endif
+    return 1;
+}
+
+// Termin un evento del bus (I2C) o un byte (SPI): avanza la transferencia
+// y, al cerrarla, actualiza la estadstica del esclavo con su respuesta. La
+// respuesta refleja la trama anterior, as que se compara con SALUD.ENVIADO
+// antes de guardar ah las posiciones de la trama que acaba de salir. Corre
+// en la interrupcin: la revisin va aqu mismo y no en otra funcin para no
+// sumar un nivel de pila a isr()
+void SPI_SIGUIENTE(void){
+    struct SALUD_ESCLAVO *S;
+    uint8_t J, SUMA = 0, IGUAL = 1, N = 2;
+    if(!SPI_OCUPADO){
+        return;
+    }
+#if TRANSPORTE_I2C
+    // Transferencia {inicio, direccin + escritura, cuerpo, reinicio,
+    // direccin + lectura, respuesta, parada}. Si el esclavo no reconoce un
+    // byte se para y la respuesta queda invlida
+    switch(I2C_ESTADO){
+        case I2C_INICIO:
+            HW_SPI_ENVIAR((I2C_BASE + SPI_ESCLAVO) << 1);
+            I2C_ESTADO = I2C_DATOS;
+            return;
+        case I2C_DATOS:
+            if(HW_I2C_NACK()){
+                break;
+            }
+            if(SPI_N < SPI_LEN){
+                HW_SPI_ENVIAR(SPI_TRAMA[SPI_N++]);
+            }
+            else{
+                HW_I2C_REINICIO();
+                I2C_ESTADO = I2C_REINICIO;
+            }
+            return;
+        case I2C_REINICIO:
+            HW_SPI_ENVIAR(((I2C_BASE + SPI_ESCLAVO) << 1) | 1);
+            I2C_ESTADO = I2C_LECTURA;
+            return;
+        case I2C_LECTURA:
+            if(HW_I2C_NACK()){
+                break;
+            }
+            SPI_N = 0;
+            HW_I2C_RECIBIR();
+            I2C_ESTADO = I2C_RECIBIR;
+            return;
+        case I2C_RECIBIR:
+            SPI_RESPUESTA[SPI_N++] = DATO_SPI;
+            HW_I2C_ACK(SPI_N >= SPI_RESPUESTA_LEN);     // NACK en el ltimo byte
+            I2C_ESTADO = I2C_ACK;
+            return;
+        case I2C_ACK:
+            if(SPI_N < SPI_RESPUESTA_LEN){
+                HW_I2C_RECIBIR();
+                I2C_ESTADO = I2C_RECIBIR;
+                return;
+            }
+            HW_I2C_PARADA();
+            I2C_ESTADO = I2C_PARADA;
+            return;
+        default:                            // I2C_PARADA: termin la transferencia
+            break;
+    }
+    if(I2C_ESTADO != I2C_PARADA){           // Falta de ACK
+        I2C_INVALIDAR();
+        HW_I2C_PARADA();
+        I2C_ESTADO = I2C_PARADA;
+        return;
+    }
+#else
+    if(SPI_N <= SPI_RESPUESTA_LEN){
+        SPI_RESPUESTA[SPI_N - 1] = DATO_SPI;
+    }
+    if(SPI_N < SPI_LEN){
+        HW_SPI_ENVIAR(SPI_TRAMA[SPI_N++]);
+        return;
+    }
+    HW_SPI_CS(SPI_ESCLAVO, 1);
+#endif
+    // SALUD[SPI_ESCLAVO] multiplica por un tamao que no es potencia de 2 y XC8
+    // lo resuelve con una llamada a su rutina de multiplicar
+    S = SALUD;
+    for(J = SPI_ESCLAVO; J; J--){
+        S++;
+    }
+    for(J = 0; J < SPI_RESPUESTA_LEN; J++){
+        SUMA += SPI_RESPUESTA[J];
+    }
+    if(SUMA != SPI_RESP_SUMA){              // Esclavo ausente o respuesta corrupta
+        if(S->FALLOS < 255){
+            S->FALLOS++;
+        }
+    }
+    else{
+        if(S->FALLOS == 0 && SPI_RESPUESTA[0] == S->CONTADOR){
+            S->PERDIDAS++;                  // No acept la trama anterior
+        }
+        S->FALLOS = 0;
+        S->CONTADOR = SPI_RESPUESTA[0];
+        if(SPI_RESPUESTA[1] != 0){
+            S->ERRORES++;
+        }
+        S->TRAMAS++;
+        for(J = 0; J < CANALES_ESCLAVO; J++){
+            S->POS[J] = SPI_RESPUESTA[2 + J];
+            if(S->POS[J] != S->ENVIADO[J]){
+                IGUAL = 0;
+            }
+        }
+        if(IGUAL){
+            S->RETRASO = 0;
+        }
+        else if(S->RETRASO < 255){
+            S->RETRASO++;
+            if(S->RETRASO > S->RETRASO_MAX){
+                S->RETRASO_MAX = S->RETRASO;
+            }
+        }
+    }
+    for(J = 0; J < CANALES_ESCLAVO; J++){   // Posiciones de la trama que acaba de salir
+        if(SPI_TRAMA[1] & (1 << J)){
+            S->ENVIADO[J] = SPI_TRAMA[N++];
+        }
+    }
+    SPI_OCUPADO = 0;
+}
+
+#if TRANSPORTE_I2C
+// Colisin en el bus (BCLIF): el MSSP abandona la transferencia sin dar
+// SSPIF. I2C_LIBERAR suelta el bus y deja SSPIF en 1, as SPI_SIGUIENTE
+// cierra la trama como fallo y el siguiente turno sale normalmente
+void I2C_COLISION(void){
+    I2C_LIBERAR();
+    I2C_INVALIDAR();
+    I2C_ESTADO = I2C_PARADA;
+}
+
+// Respuesta en ceros: no pasa la suma y SPI_SIGUIENTE la cuenta como fallo
+void I2C_INVALIDAR(void){
+    uint8_t J;
+    for(J = 0; J < SPI_RESPUESTA_LEN; J++){
+        SPI_RESPUESTA[J] = 0;
+    }
+}
+#endif
+
+// Agrega la posicin actual a la trayectoria; cada FLASH_BLOQUE palabras se
+// escribe un bloque completo. FLASH_MAX*FLASH_PALABRAS_MUESTRA es mltiplo
+// del bloque, as que al llenarse la regin no queda un bloque a medias
+void FLASH_GRABAR_MUESTRA(void){
+    if(FLASH_INDICE >= FLASH_MAX){          // Regin llena: termina la grabacin
+        FLASH_CUENTA = FLASH_INDICE;
+        BANDERA_CUENTA = 1;
+        FLASH_ESTADO = FLASH_LIBRE;
+        return;
+    }
+    FLASH_BUFFER[FLASH_LLENAS] = ((uint16_t)COMPRIMIR_7(POT_1) << 7) | COMPRIMIR_7(POT_2);
+    FLASH_BUFFER[FLASH_LLENAS + 1] = ((uint16_t)COMPRIMIR_7(POT_3) << 7) | COMPRIMIR_7(POT_4);
+    FLASH_LLENAS += FLASH_PALABRAS_MUESTRA;
+    FLASH_INDICE++;
+    if(FLASH_LLENAS >= FLASH_BLOQUE){
+        FLASH_ESCRIBIR_BLOQUE(FLASH_INICIO + FLASH_INDICE*FLASH_PALABRAS_MUESTRA - FLASH_BLOQUE, FLASH_BUFFER);
+        FLASH_LLENAS = 0;
+    }
+}
+
+// Lector de la reproduccin: una muestra por llamada, al final vuelve al inicio
+void FLASH_LEER_MUESTRA(void){
+    uint16_t DIRECCION, PALABRA;
+    if(FLASH_INDICE >= FLASH_CUENTA){
+        FLASH_INDICE = 0;
+    }
+    DIRECCION = FLASH_INICIO + FLASH_INDICE*FLASH_PALABRAS_MUESTRA;
+    PALABRA = FLASH_LEER(DIRECCION);
+    POT_1 = EXPANDIR_7((PALABRA >> 7) & 0x7F);
+    POT_2 = EXPANDIR_7(PALABRA & 0x7F);
+    PALABRA = FLASH_LEER(DIRECCION + 1);
+    POT_3 = EXPANDIR_7((PALABRA >> 7) & 0x7F);
+    POT_4 = EXPANDIR_7(PALABRA & 0x7F);
+    FLASH_INDICE++;
+}
+
+// Termina la grabacin o la reproduccin en curso. Al grabar se escribe el
+// bloque incompleto, relleno con 0x3FFF (el valor de la flash borrada), y
+// NUCLEO_PRINCIPAL guarda el nmero de muestras
+void FLASH_DETENER(void){
+    uint8_t J;
+    if(FLASH_ESTADO == FLASH_GRABANDO){
+        if(FLASH_LLENAS > 0){
+            for(J = FLASH_LLENAS; J < FLASH_BLOQUE; J++){
+                FLASH_BUFFER[J] = 0x3FFF;
+            }
+            FLASH_ESCRIBIR_BLOQUE(FLASH_INICIO + FLASH_INDICE*FLASH_PALABRAS_MUESTRA - FLASH_LLENAS, FLASH_BUFFER);
+            FLASH_LLENAS = 0;
+        }
+        FLASH_CUENTA = FLASH_INDICE;
+        BANDERA_CUENTA = 1;
+    }
+    FLASH_ESTADO = FLASH_LIBRE;
+}
+
+/*------------------------------------------------------------------------------
+ * NUCLEO 
+ * Lgica de control independiente de los registros del PIC
+ ------------------------------------------------------------------------------*/
+// RB0 cambia de modo; RB1/RB2 guardan (MODO 0) o cargan (MODO 1) una pose.
+// En MODO 3 RB1 graba un registro de la secuencia y RB2 la reproduce o detiene.
+// En MODO 4 RB1 inicia o termina la grabacin continua y RB2 su reproduccin
+void NUCLEO_BOTONES(uint8_t BOTONES){
+    if(!(BOTONES & 0b001)){                 // RB0 presionado
+        MODO++;                             // Incremento para cambio de modo por presionar el botn
+        if (MODO >= N_MODOS){               // Condicional que no exceda de N_MODOS estados
+            MODO = 0;                       // Reinicio del modo
+        }
+        SEC_REPRODUCIENDO = 0;              // Salir del modo detiene la secuencia
+        TRAY_DESCARTAR = 1;                 // y descarta la trayectoria pendiente
+        TRAY_ACTIVA = 0;
+        SEC_NUEVA = 1;                      // Al volver, RB1 graba una secuencia nueva
+        BANDERA_ESTADO = 1;                 // Guardar el nuevo modo
+        
+        /*if(MODO == 0){
+            BANDERA_MODO2A0 = 1;
+        }*/
+    }
+    else if(!(BOTONES & 0b010)){            // RB1 presionado
+        if(MODO == 0){
+            BANDERA_E1 = 1;
+        }
+        else if(MODO == 1){
+            BANDERA_L1 = 1;
+        }
+        else if(MODO == 3){
+            BANDERA_SEC_G = 1;
+        }
+        else if(MODO == 4){
+            BANDERA_FLASH_G = 1;
+        }
+    }
+    else if(!(BOTONES & 0b100)){            // RB2 presionado
+        if(MODO == 0){
+            BANDERA_E2 = 1;
+        }
+        else if(MODO == 1){
+            BANDERA_L2 = 1;
+        }
+        else if(MODO == 3){
+            BANDERA_SEC_R = 1;
+        }
+        else if(MODO == 4){
+            BANDERA_FLASH_R = 1;
+        }
+    }
+}
+
+// Tick de 50 ms: avanza la reproduccin una articulacin por segundo
+void NUCLEO_TICK(void){
+    TICKS++;
+    if(TICKS >= TICKS_PASO){                // Transcurri 1 s
+        TICKS = 0;
+        if(BANDERA_R == 1 || BANDERA_MODO2A0 == 1){
+            PASO++;                         // Turno para la siguiente articulacin
+        }
+    }
+    if(SEC_REPRODUCIENDO == 1){             // Permanencia del registro de la secuencia
+        if(SEC_ESPERA > 0){
+            SEC_ESPERA--;
+        }
+        else{
+            BANDERA_SEC_SIG = 1;
+        }
+    }
+    else if(SEC_TICKS < 255){               // Tiempo entre registros al grabar
+        SEC_TICKS++;
+    }
+    if(FLASH_ESTADO != FLASH_LIBRE){        // Periodo de muestreo de la trayectoria
+        TICKS_MUESTRA++;
+        if(TICKS_MUESTRA >= FLASH_TICKS){
+            TICKS_MUESTRA = 0;
+            BANDERA_MUESTRA = 1;
+        }
+    }
+}
+
+// Periodo de TMR0 (2 ms): avanza la trayectoria, prepara los objetivos de
+// los canales extra, da turno al siguiente esclavo y marca cundo toca la
+// siguiente trama de telemetra
+void NUCLEO_MUESTREO(void){
+    if(MODO == 2 && !TRAY_DESCARTAR){       // Con puntos de antes del cambio de modo se espera a main
+        NUCLEO_TRAYECTORIA();
+    }
+#if N_ESCLAVOS > 1
+    while(EXTRA_INICIO != EXTRA_FIN){
+        SPI_PREPARAR(EXTRA_CANAL[EXTRA_INICIO] / CANALES_ESCLAVO,
+                     EXTRA_CANAL[EXTRA_INICIO] % CANALES_ESCLAVO, EXTRA_POS[EXTRA_INICIO]);
+        EXTRA_INICIO = (EXTRA_INICIO + 1) & EXTRA_MASK;
+    }
+#endif
+    if(++TICKS_SPI >= SPI_PERIODO && SPI_TRANSMITIR(SPI_TURNO)){
+        TICKS_SPI = 0;                      // Con el bus ocupado se reintenta en el siguiente periodo
+        if(++SPI_TURNO >= N_ESCLAVOS){
+            SPI_TURNO = 0;
+            BANDERA_LATCH = 1;              // Sali la trama del ltimo esclavo
+        }
+    }
+    if(TELEMETRIA_PERIODO == 0){
+        return;
+    }
+    TICKS_TELEMETRIA++;
+    if(TICKS_TELEMETRIA >= TELEMETRIA_PERIODO){
+        TICKS_TELEMETRIA = 0;
+        BANDERA_TELEMETRIA = 1;
+    }
+}
+
+// Fin de un periodo del PWM: baja la lnea LATCH del pulso anterior y, si la
+// ronda ya termin de transmitirse, carga los CCP propios y da el siguiente.
+// Los CCP toman el valor en el prximo lmite de periodo, el mismo en que lo
+// toman los esclavos que reinician su TMR2 con el flanco
+void NUCLEO_PERIODO_PWM(void){
+    if(LATCH_ALTO){
+        HW_LATCH(0);
+        LATCH_ALTO = 0;
+        return;
+    }
+    if(BANDERA_LATCH && !SPI_OCUPADO){
+        HW_CCP1(CCP_ESPERA[0]);
+        HW_CCP2(CCP_ESPERA[1]);
+        HW_LATCH(1);
+        LATCH_ALTO = 1;
+        BANDERA_LATCH = 0;
+    }
+}
+
+// Aplica los puntos de la cola cuya T ya lleg. Un punto atrasado se aplica
+// de inmediato sin mover el reloj, as los siguientes conservan su ritmo. Si
+// la cola queda vaca TRAY_ESPERA periodos el reloj se detiene y el prximo
+// punto vuelve a fijar el origen
+void NUCLEO_TRAYECTORIA(void){
+    if(TRAY_INICIO == TRAY_FIN){
+        if(TRAY_ACTIVA && ++TRAY_VACIA >= TRAY_ESPERA){
+            TRAY_ACTIVA = 0;
+        }
+        else{
+            TRAY_RELOJ++;
+        }
+        return;
+    }
+    if(!TRAY_ACTIVA){
+        TRAY_RELOJ = TRAY_TIEMPO[TRAY_INICIO];
+        TRAY_ACTIVA = 1;
+    }
+    else{
+        TRAY_RELOJ++;
+    }
+    TRAY_VACIA = 0;
+    while(TRAY_INICIO != TRAY_FIN && (int16_t)(TRAY_RELOJ - TRAY_TIEMPO[TRAY_INICIO]) >= 0){
+        POT_1_E = TRAY_POS[TRAY_INICIO][0];
+        POT_2_E = TRAY_POS[TRAY_INICIO][1];
+        POT_3_E = TRAY_POS[TRAY_INICIO][2];
+        POT_4_E = TRAY_POS[TRAY_INICIO][3];
+        TRAY_INICIO = (TRAY_INICIO + 1) & TRAY_MASK;
+    }
+}
+
+// Muestra del ADC: actualiza la posicin del canal segn el modo y la enva
+// al CCP local (AN0/AN1) o al esclavo (AN2/AN3)
+void NUCLEO_ADC(uint8_t CANAL, uint8_t MUESTRA){
+    struct DUTY DUTY_PWM;                   // Entrada de tabla para el CCP
+    if(EN_ESPERA(CANAL)){                   // La articulacin conserva su posicin hasta su turno
+        return;
+    }
+    if(CANAL == 0){                         // AN0 -> CCP1
+        if(MANUAL()){
+            POT_1 = MUESTRA;
+        }
+        else if (MODO == 2){
+            POT_1 = ACERCAR(POT_1, POT_1_E, 0);     // Posicion recibida por USART
+        }
+        else{
+            POT_1_E = POT_1;                // MODO 2 arranca desde la posicin actual
+        }
+        DUTY_PWM = TABLA_POT[POT_1];
+        SALIDA_CCP1(DUTY_PWM);
+    }
+    else if(CANAL == 1){                    // AN1 -> CCP2
+        if(MANUAL()){
+            POT_2 = MUESTRA;
+        }
+        else if (MODO == 2){
+            POT_2 = ACERCAR(POT_2, POT_2_E, 1);     // Posicion recibida por USART
+        }
+        else{
+            POT_2_E = POT_2;
+        }
+        DUTY_PWM = TABLA_POT[POT_2];
+        SALIDA_CCP2(DUTY_PWM);
+    }
+    else if(CANAL == 2){                    // AN2 -> CCP1 del ESCLAVO1
+        if(MANUAL()){
+            POT_3 = MUESTRA;
+        }
+        else if(MODO == 2){
+            POT_3 = ACERCAR(POT_3, POT_3_E, 2);     // Posicion recibida por USART
+        }
+        else{
+            POT_3_E = POT_3;
+        }
+        SPI_PREPARAR(0, 0, POT_3);
+    }
+    else if(CANAL == 3){                    // AN3 -> CCP2 del ESCLAVO1
+        if(MANUAL()){
+            POT_4 = MUESTRA;
+        }
+        else if(MODO == 2){
+            POT_4 = ACERCAR(POT_4, POT_4_E, 3);     // Posicion recibida por USART
+        }
+        else{
+            POT_4_E = POT_4;
+        }
+        SPI_PREPARAR(0, 1, POT_4);
+    }
+}
+
+// Avanza ACTUAL hacia OBJETIVO sin superar la velocidad del canal (Set Speed
+// de Pololu); con velocidad y aceleracin 0 llega de inmediato. Con
+// aceleracin (Set Acceleration) la velocidad sube por rampa desde 0 hasta
+// la del canal; solo hay rampa de subida, frenar antes del objetivo pedira
+// una multiplicacin de 32 bits en la interrupcin
+uint8_t ACERCAR(uint8_t ACTUAL, uint8_t OBJETIVO, uint8_t CANAL){
+    uint16_t LIMITE = VELOCIDAD[CANAL];
+    uint8_t PASOS;
+    if(ACTUAL == OBJETIVO || (LIMITE == 0 && ACELERACION[CANAL] == 0)){
+        AVANCE[CANAL] = 0;
+        VEL_ACTUAL[CANAL] = 0;              // El siguiente movimiento arranca de nuevo la rampa
+        return OBJETIVO;
+    }
+    if(ACELERACION[CANAL] != 0){
+        if(LIMITE == 0){
+            LIMITE = 0x7FFF;                // Sin lmite de velocidad, el mismo tope de Set Speed
+        }
+        if(VEL_ACTUAL[CANAL] >= LIMITE || LIMITE - VEL_ACTUAL[CANAL] <= ACELERACION[CANAL]){
+            VEL_ACTUAL[CANAL] = LIMITE;
+        }
+        else{
+            VEL_ACTUAL[CANAL] += ACELERACION[CANAL];
+        }
+        LIMITE = VEL_ACTUAL[CANAL];
+    }
+    LIMITE += AVANCE[CANAL];
+    PASOS = (uint8_t)(LIMITE >> 8);
+    AVANCE[CANAL] = (uint8_t)LIMITE;
+    if(ACTUAL < OBJETIVO){
+        return (OBJETIVO - ACTUAL <= PASOS) ? OBJETIVO : ACTUAL + PASOS;
+    }
+    return (ACTUAL - OBJETIVO <= PASOS) ? OBJETIVO : ACTUAL - PASOS;
+}
+
+// Estado guardado en la EEPROM al encender: modo, ltima posicin, secuencia
+// y nmero de muestras de la trayectoria en la flash
+void NUCLEO_INICIAR(void){
+    LOG_RECUPERAR();                        // Poses, modo y posicin guardados
+    if(LOG_RANURA[CLAVE_MODO] != LOG_VACIO && LOG_VALOR[CLAVE_MODO][0] < N_MODOS){
+        MODO = LOG_VALOR[CLAVE_MODO][0];
+    }
+    if(LOG_RANURA[CLAVE_ULTIMA] != LOG_VACIO){
+        POT_1 = LOG_VALOR[CLAVE_ULTIMA][0];
+        POT_2 = LOG_VALOR[CLAVE_ULTIMA][1];
+        POT_3 = LOG_VALOR[CLAVE_ULTIMA][2];
+        POT_4 = LOG_VALOR[CLAVE_ULTIMA][3];
+    }
+    POT_1_E = POT_1;                        // MODO 2 restaurado parte de la posicin
+    POT_2_E = POT_2;                        // recuperada y no va hacia 0
+    POT_3_E = POT_3;
+    POT_4_E = POT_4;
+    LEER_SECUENCIA();                       // Registros vlidos de la secuencia
+    if(LOG_RANURA[CLAVE_FLASH] != LOG_VACIO && LOG_VALOR[CLAVE_FLASH][0] == FLASH_MAGICO){
+        FLASH_CUENTA = LOG_VALOR[CLAVE_FLASH][1] | ((uint16_t)LOG_VALOR[CLAVE_FLASH][2] << 8);
+        if(FLASH_CUENTA > FLASH_MAX){
+            FLASH_CUENTA = FLASH_MAX;
+        }
+    }
+}
+
+// Una vuelta del ciclo principal: comandos USART, telemetra y las acciones de
+// los botones de cada modo. main() y la simulacin la llaman sin fin
+void NUCLEO_PRINCIPAL(void){
+    uint8_t DATOS_CUENTA[4];
+    PROCESAR_USART();                   // Comandos recibidos por USART
+    if(BANDERA_TELEMETRIA == 1){
+        ENVIAR_TELEMETRIA();
+        BANDERA_TELEMETRIA = 0;
+    }
+    
+    if(PASO >= PASOS_REPRODUCCION){     // Termin la reproduccin de la pose
+        BANDERA_R = 0;
+        BANDERA_MODO2A0 = 0;
+        PASO = 0;
+    }
+    
+    if(BANDERA_ESTADO == 1){            // Cambio de modo
+        if(MODO != 4){
+            FLASH_DETENER();            // Cierra una grabacin que qued abierta
+        }
+        GUARDAR_ESTADO();
+        BANDERA_ESTADO = 0;
+    }
+    
+    if (MODO == 0){
+        if (BANDERA_E1 == 1){
+            GUARDAR_POSE(0);
+            BANDERA_E1 = 0;
+        }
+        if(BANDERA_E2 == 1){
+            GUARDAR_POSE(1);
+            BANDERA_E2 = 0;
+        }
+    }
+    else if (MODO == 1){
+        if (BANDERA_L1 == 1){
+            CARGAR_POSE(0);
+            GUARDAR_ESTADO();
+            TICKS = 0;                  // La primera articulacin se mueve tras 1 s
+            PASO = 0;
+            BANDERA_R = 1;
+            BANDERA_L1 = 0;
+        }
+        if (BANDERA_L2 == 1){
+            CARGAR_POSE(1);
+            GUARDAR_ESTADO();
+            TICKS = 0;                  // La primera articulacin se mueve tras 1 s
+            PASO = 0;
+            BANDERA_R = 1;
+            BANDERA_L2 = 0;
+        }
+    }
+    else if (MODO == 3){
+        if (BANDERA_SEC_G == 1){
+            GRABAR_REGISTRO();
+            BANDERA_SEC_G = 0;
+        }
+        if (BANDERA_SEC_R == 1){
+            if (SEC_REPRODUCIENDO == 1){
+                SEC_REPRODUCIENDO = 0;  // Los potencimetros retoman el control
+            }
+            else if (SEC_CUENTA > 0){
+                SEC_INDICE = 0;
+                CARGAR_REGISTRO(0);
+                SEC_REPRODUCIENDO = 1;
+            }
+            BANDERA_SEC_SIG = 0;        // Descarta un fin de permanencia anterior
+            BANDERA_SEC_R = 0;
+        }
+        if (BANDERA_SEC_SIG == 1){      // Siguiente registro, al final vuelve al primero
+            SEC_INDICE++;
+            if (SEC_INDICE >= SEC_CUENTA){
+                SEC_INDICE = 0;
+            }
+            CARGAR_REGISTRO(SEC_INDICE);
+            BANDERA_SEC_SIG = 0;
+        }
+    }
+    else if (MODO == 4){
+        if (BANDERA_FLASH_G == 1){
+            if (FLASH_ESTADO == FLASH_GRABANDO){
+                FLASH_DETENER();
+            }
+            else{
+                FLASH_DETENER();
+                FLASH_INDICE = 0;
+                FLASH_LLENAS = 0;
+                FLASH_CUENTA = 0;       // La trayectoria anterior deja de ser vlida
+                BANDERA_CUENTA = 1;
+                FLASH_ESTADO = FLASH_GRABANDO;
+            }
+            BANDERA_FLASH_G = 0;
+        }
+        if (BANDERA_FLASH_R == 1){
+            if (FLASH_ESTADO == FLASH_REPRODUCIENDO){
+                FLASH_DETENER();        // Los potencimetros retoman el control
+            }
+            else if (FLASH_CUENTA > 0){
+                FLASH_DETENER();
+                FLASH_INDICE = 0;
+                FLASH_ESTADO = FLASH_REPRODUCIENDO;
+            }
+            BANDERA_FLASH_R = 0;
+        }
+        if (BANDERA_MUESTRA == 1){
+            if (FLASH_ESTADO == FLASH_GRABANDO){
+                FLASH_GRABAR_MUESTRA();
+            }
+            else if (FLASH_ESTADO == FLASH_REPRODUCIENDO){
+                FLASH_LEER_MUESTRA();
+            }
+            BANDERA_MUESTRA = 0;
+        }
+    }
+    // Nmero de muestras de la trayectoria: se guarda aqu y no dentro de
+    // FLASH_DETENER, as LOG_ESCRIBIR queda a un solo nivel de NUCLEO_PRINCIPAL
+    if(BANDERA_CUENTA == 1){
+        DATOS_CUENTA[0] = FLASH_MAGICO;
+        DATOS_CUENTA[1] = (uint8_t)FLASH_CUENTA;
+        DATOS_CUENTA[2] = (uint8_t)(FLASH_CUENTA >> 8);
+        DATOS_CUENTA[3] = 0;
+        LOG_ESCRIBIR(CLAVE_FLASH, DATOS_CUENTA);
+        BANDERA_CUENTA = 0;
+    }
+    HW_LEDS(LEDS_MODO[MODO]);           // RE0 -> MODO 0, RE1 -> MODO 1, RE2 -> MODO 2, todos -> MODO 3, RE0 y RE1 -> MODO 4
+}
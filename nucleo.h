@@ -0,0 +1,415 @@
+/* 
+ * File:   nucleo.h
+ * Constantes, estado compartido y funciones del ncleo del maestro: protocolo
+ * USART, registro en EEPROM, tramas a los esclavos y las rutinas NUCLEO_*.
+ * No incluye xc.h; los registros quedan en hw.h (o en la simulacin de gcc)
+ */
+
+#ifndef NUCLEO_H
+#define NUCLEO_H
+
+#include <stdint.h>
+
+/*------------------------------------------------------------------------------
+ * CONSTANTES 
+ ------------------------------------------------------------------------------*/
+#define IN_MIN 0                
+#define IN_MAX 255              // Valores de entrada a Potenciometro
+#define OUT_MIN1 135             
+#define OUT_MAX1 580             // Valores para el servomotor MG996R ---> en realidad debera de ser 125 y 600 pero se disminuyeron para que giraran casi 180 grados
+
+// Escalamiento en punto fijo: pendiente (y1-y0)/(x1-x0) en Q16 calculada en
+// compilacin. Se redondea hacia arriba para reproducir exactamente el
+// truncamiento del map() en flotante para todas las entradas x0..255
+#define MAP_Q 16
+#define PENDIENTE(x0, x1, y0, y1) (((((uint32_t)((y1)-(y0)))<<MAP_Q) + ((x1)-(x0)) - 1)/((x1)-(x0)))
+#define PEND_1 PENDIENTE(IN_MIN, IN_MAX, OUT_MIN1, OUT_MAX1)      // Potenciometro/USART -> CCP
+#define PEND_INV PENDIENTE(OUT_MIN1, OUT_MAX1, IN_MIN, IN_MAX)    // CCP -> posicin (Pololu)
+
+// Generador de tablas: ESCALA() evalua en compilacin el mismo punto fijo,
+// saturado al rango de calibracin [y0, y1], y TABLA_256() lo expande para
+// las 256 entradas posibles del ADC/USART
+#define ESCALA_FX(x, x0, y0, pend) ((y0) + ((((uint32_t)(x)-(x0))*(pend))>>MAP_Q))
+#define ESCALA(x, x0, y0, y1, pend) ((x) <= (x0) ? (y0) : \
+        (ESCALA_FX(x, x0, y0, pend) > (y1) ? (y1) : ESCALA_FX(x, x0, y0, pend)))
+#define TABLA_4(m, x)   m(x) m((x)+1) m((x)+2) m((x)+3)
+#define TABLA_16(m, x)  TABLA_4(m, x) TABLA_4(m, (x)+4) TABLA_4(m, (x)+8) TABLA_4(m, (x)+12)
+#define TABLA_64(m, x)  TABLA_16(m, x) TABLA_16(m, (x)+16) TABLA_16(m, (x)+32) TABLA_16(m, (x)+48)
+#define TABLA_256(m)    TABLA_64(m, 0) TABLA_64(m, 64) TABLA_64(m, 128) TABLA_64(m, 192)
+
+// Entradas listas para los registros: CCPRxL y DCxB ya en los bits 5:4 de CCPxCON
+#define DUTY_CCP(d)     {(uint8_t)((d)>>2), (uint8_t)(((d) & 0b11)<<4)},
+#define DUTY_POT(x)     DUTY_CCP(ESCALA(x, IN_MIN, OUT_MIN1, OUT_MAX1, PEND_1))
+
+// Reproduccin de poses con el tick de 50 ms de TMR1
+#define TICKS_PASO 20           // 1 s entre articulaciones al reproducir una pose
+#define PASOS_REPRODUCCION 5    // AN0..AN3 y una vuelta extra, como el antiguo CONT > 4
+// Durante la reproduccin, el canal espera hasta que el marcapasos le d turno
+#define EN_ESPERA(canal) (((MODO == 0 && BANDERA_MODO2A0 == 1) || \
+        (MODO == 1 && BANDERA_R == 1)) && PASO <= (canal))
+
+// Trama SPI a los esclavos, dentro de una sola ventana de chip-select:
+// {SPI_CABECERA, MASCARA, una posicin por cada bit en 1 de MASCARA (canal 0
+// primero), SUMA}. SUMA hace que MASCARA + posiciones + SUMA den 0 (mod 256);
+// es una suma y no el CRC8 de la USART porque la trama se arma en el ISR
+#define SPI_CABECERA 0x5A
+#define N_ESCLAVOS 1            // Hasta 8 (16 canales); cada esclavo suma ~15 bytes de RAM
+#define CANALES_ESCLAVO 2       // CCP1 y CCP2 de cada esclavo
+#define N_SALIDAS (2 + CANALES_ESCLAVO*N_ESCLAVOS)  // CCP propios y canales de los esclavos
+// Los esclavos se atienden por turnos, una trama cada SPI_PERIODO periodos de
+// TMR0: 4 -> 125 tramas/s en total, repartidas entre los N_ESCLAVOS
+#define SPI_PERIODO 4
+// Transporte a los esclavos: 0 -> SPI con chip-select, 1 -> I2C en RC3/RC4
+// (SCL/SDA) con el esclavo n en I2C_BASE + n. En I2C se escribe el cuerpo de
+// la trama {MASCARA, posiciones, SUMA} y, tras un reinicio, se leen los
+// SPI_RESPUESTA_LEN bytes de estado. Medido con make simulacion (trama de 2
+// canales, 1 s con SPI_PERIODO 4): SPI 5 bytes y 5 SSPIF por trama, 160 us
+// de bus; I2C 11 bytes y 19 SSPIF por trama, ~1.2 ms de bus a 83 kHz. Ambos
+// dan las 125 tramas/s. Cada SSPIF es una entrada a isr(); su costo en
+// ciclos sale de make medir_isr (ruta "otras") y no est sumado aqu
+#ifndef TRANSPORTE_I2C
+#define TRANSPORTE_I2C 0
+#endif
+#define I2C_BASE 0x10           // Direccin de 7 bits del ESCLAVO1
+#define I2C_INICIO 0            // Estados de la transferencia I2C
+#define I2C_DATOS 1
+#define I2C_REINICIO 2
+#define I2C_LECTURA 3
+#define I2C_RECIBIR 4
+#define I2C_ACK 5
+#define I2C_PARADA 6
+// Actualizacin en dos fases: con LATCH_SIMULTANEO las tramas llevan el bit
+// MASCARA_LATCH y el esclavo solo guarda las posiciones. Terminada la ronda
+// por todos los esclavos, en el siguiente fin de periodo del PWM (TMR2IF) el
+// maestro carga sus CCP y sube la lnea LATCH (RA5), compartida por todas las
+// placas; en el flanco de subida cada esclavo carga sus CCP y reinicia su
+// TMR2, as todas las articulaciones cambian en el mismo lmite de periodo.
+// Requiere un firmware de esclavo que entienda MASCARA_LATCH, as que por
+// omisin cada esclavo aplica la trama al recibirla
+#ifndef LATCH_SIMULTANEO
+#define LATCH_SIMULTANEO 0
+#endif
+#define MASCARA_LATCH 0x80
+// Mientras recibe una trama, el esclavo devuelve por MISO el estado que dej
+// la trama anterior: {CONTADOR de tramas vlidas, ESTADO (0 sin error),
+// posicin aplicada de cada canal, SUMA}, con todos los bytes sumando
+// SPI_RESP_SUMA. Si la trama es ms corta se completa con ceros
+#define SPI_RESPUESTA_LEN (CANALES_ESCLAVO + 3)
+#define SPI_RESP_SUMA 0xFF      // Ni MISO en 0 ni en 1 pasan la suma
+#define SPI_TRAMA_MAX (CANALES_ESCLAVO + 3 > SPI_RESPUESTA_LEN ? CANALES_ESCLAVO + 3 : SPI_RESPUESTA_LEN)
+// Buffers de la USART: RX guarda ~17 ms de bytes a 9600 baudios y TX una
+// trama de TRAMA_MAX datos (TRAMA_MAX + 4 bytes) ms un byte
+#define RX_TAM 16               // Bytes del buffer de recepcin USART (potencia de 2)
+#define RX_MASK (RX_TAM - 1)
+#define TX_TAM 16               // Bytes del buffer de transmisin USART (potencia de 2)
+#define TX_MASK (TX_TAM - 1)
+
+// Protocolo USART: {TRAMA_SYNC, CMD, LEN, LEN bytes de datos, CRC-8 de CMD,
+// LEN y datos}. Las posiciones usan todo el rango 0 - 255, igual que los
+// potencimetros. Cada trama vlida se contesta con CMD | CMD_RESPUESTA
+#define TRAMA_SYNC 0xA5
+#define TRAMA_MAX 10            // Bytes de datos como mximo
+#define CMD_POSICION 0x01       // {servo 0 - 3, posicin} -> {estado}
+#define CMD_POSICIONES 0x02     // {POT_1, POT_2, POT_3, POT_4} -> {estado}
+#define CMD_CONSULTA 0x03       // {} -> {POT_1, POT_2, POT_3, POT_4}
+#define CMD_TELEMETRIA 0x04     // {periodo en unidades de 2 ms, 0 apaga} -> {estado}
+// Trama de telemetra, sin pedirla, cada TELEMETRIA_PERIODO periodos de TMR0:
+// {SEC, MODO, POT_1..POT_4, ERRORES_OERR, ERRORES_FERR, ERRORES_RX, ERRORES_TRAMA}.
+// Son 14 bytes por trama: a 9600 baudios (960 bytes/s) caben ~68 tramas/s,
+// as que 50 Hz (periodo 10) entra y 100 Hz (periodo 5) necesita
+// BAUD_SPBRG 12 (19200, ~137 tramas/s)
+#define TRAMA_TELEMETRIA 0xC0
+#define TELEMETRIA_LEN 10
+#define CMD_TRAYECTORIA 0x05    // {T bajo, T alto, POT_1..POT_4} o {} -> {estado, libres}
+#define CMD_ESCLAVO 0x06        // {esclavo} -> {FALLOS, ERRORES, PERDIDAS, RETRASO,
+                                //  RETRASO_MAX, TRAMAS, posicin de cada canal}
+#define CMD_RESPUESTA 0x80
+#define ESTADO_OK 0
+#define ESTADO_MODO 1           // Las posiciones solo se aceptan en MODO 2
+#define ESTADO_INVALIDO 2       // Comando, longitud o servo desconocido
+#define ESTADO_LLENO 3          // Cola de trayectoria llena, el punto no se guard
+#define RX_SYNC 0               // Estados del receptor de tramas
+#define RX_CMD 1
+#define RX_LEN 2
+#define RX_DATOS 3
+#define RX_CRC 4
+#define RX_POLOLU 5             // Datos de un comando Pololu o Mini-SSC
+
+// Compatibilidad con el protocolo compacto de Pololu Maestro y con Mini-SSC.
+// Canales 0/1 -> CCP1/CCP2, 2/3 -> CCP1/CCP2 del ESCLAVO1, 4/5 -> ESCLAVO2 y
+// as hasta N_SALIDAS. Los objetivos van en cuartos de us; una cuenta del
+// CCP son 4 us (Fosc/4 = 1 us, TMR2 1:4)
+#define POLOLU_OBJETIVO 0x84    // canal, 7 bits bajos, 7 bits altos
+#define POLOLU_VELOCIDAD 0x87   // canal, 7 bits bajos, 7 bits altos
+#define POLOLU_ACELERACION 0x89 // canal, 7 bits bajos, 7 bits altos (0 - 255)
+#define POLOLU_POSICION 0x90    // canal -> 2 bytes, cuartos de us
+#define POLOLU_MOVIMIENTO 0x93  // -> 1 byte, 1 si algn canal no llega a su objetivo
+#define MINI_SSC 0xFF           // canal, posicin 0 - 254
+#define N_SERVOS 4
+#define CUARTOS_US 16           // Cuartos de us por cuenta del CCP
+// Objetivos de los canales extra (4 en adelante): main los encola y
+// NUCLEO_MUESTREO los pasa a SPI_PREPARAR en la interrupcin. Con un solo
+// esclavo no hay canales extra y la cola no ocupa RAM
+#define EXTRA_TAM 8             // Objetivos en la cola (potencia de 2)
+#define EXTRA_MASK (EXTRA_TAM - 1)
+// Velocidad Pololu: V cuartos de us cada 10 ms. Cada canal se actualiza cada
+// 8 ms y una posicin son 445*16/255 cuartos de us, as que el avance por
+// actualizacin en Q8 es V*0.8*256*255/(445*16) = V*7.33 = (V*1877)>>8
+#define VEL_Q8(v) (((uint32_t)(v)*1877)>>8)
+// Aceleracin Pololu: A cuartos de us cada 10 ms por cada 80 ms, o sea A/10
+// de velocidad por actualizacin de 8 ms: A*7.33/10 = (A*188)>>8 en Q8. Se
+// redondea hacia arriba para que A = 1 no quede en 0
+#define ACEL_Q8(a) ((uint8_t)(((uint16_t)(a)*188 + 255)>>8))
+
+// Trayectoria transmitida en MODO 2: el host encola puntos con su instante T
+// en unidades de 2 ms y el ISR los aplica cuando el reloj de la trayectoria
+// llega a T, as el retraso del PC no cambia el ritmo del movimiento. El
+// reloj arranca en la T del primer punto; cada respuesta lleva los lugares
+// libres (crditos) y el host no debe enviar ms puntos que esos
+// TRAY_TAM - 1 puntos en espera: con puntos cada 40 ms el host puede
+// detenerse 120 ms sin que llegue tarde ninguno (PRUEBA_COLA_TRAYECTORIA)
+#define TRAY_TAM 4              // Puntos en la cola (potencia de 2)
+#define TRAY_MASK (TRAY_TAM - 1)
+#define TRAY_ESPERA 250         // Periodos de TMR0 con la cola vaca antes de detener el reloj
+#define N_POSES 2               // Poses guardadas (RB1 y RB2)
+#define DIR_POSE(n) (1 + 4*(n)) // Direccin de la pose n en versiones anteriores
+
+// Registro circular en la EEPROM para el estado que se guarda seguido: cada
+// cambio se agrega en la cabeza como {SEC, CLAVE, 4 datos, CRC} en lugar de
+// reescribir siempre las mismas celdas, as el desgaste se reparte entre
+// todas las ranuras. Al arrancar, la SEC ms nueva de cada clave es su valor
+#define LOG_BASE 0xC0           // Despus de la regin de la secuencia
+#define LOG_TAM_REG 7
+#define LOG_RANURAS 9           // 0xC0 - 0xFE
+#define DIR_RANURA(r) (LOG_BASE + (r)*LOG_TAM_REG)
+#define LOG_VACIO 0xFF          // Ranura o clave sin registro
+#define CLAVE_POSE(n) (n)       // Poses de RB1/RB2
+#define CLAVE_ULTIMA N_POSES    // ltima posicin de las articulaciones
+#define CLAVE_MODO (N_POSES + 1)
+#define CLAVE_FLASH (N_POSES + 2)   // {FLASH_MAGICO, muestras (16 bits), 0}
+#define LOG_CLAVES (N_POSES + 3)
+// Las SEC de las ranuras difieren en menos de LOG_RANURAS, as que se
+// comparan con aritmtica de 8 bits aunque den la vuelta
+#define MAS_NUEVA(a, b) ((int8_t)((uint8_t)((a) - (b))) > 0)
+// CRC-8 de los registros (polinomio x^8 + x^2 + x + 1, valor inicial 0). En el
+// registro circular incluye la SEC, que se escribe al ltimo para confirmarlo
+#define CRC8_POLI 0x07
+
+// Secuencia de poses (MODO 3) en la EEPROM: cabecera {SEC_MAGICO, cuenta} y
+// registros de tamao fijo {POT_1..POT_4, permanencia en ticks de 50 ms, CRC}, de
+// modo que el registro i est en una direccin calculada, sin recorrer la lista
+#define SEC_BASE 0x10           // Cabecera, despus de las poses de RB1/RB2
+#define SEC_MAGICO 0x5F         // Marca de secuencia vlida (registros con CRC)
+#define SEC_REGISTROS (SEC_BASE + 2)
+#define SEC_TAM_REG 6
+#define SEC_LIMITE 0xC0         // Fin de la regin de la secuencia
+#define SEC_MAX ((SEC_LIMITE - SEC_REGISTROS)/SEC_TAM_REG)     // 29 registros
+#define DIR_REGISTRO(i) (SEC_REGISTROS + (i)*SEC_TAM_REG)
+#define SEC_ESPERA_FINAL 20     // Permanencia del ltimo registro grabado (1 s)
+// La posicin sigue a los potencimetros en MODO 0 y en MODO 3 sin reproducir
+#define MANUAL() (MODO == 0 || (MODO == 3 && SEC_REPRODUCIENDO == 0) || \
+        (MODO == 4 && FLASH_ESTADO != FLASH_REPRODUCIENDO))
+#define N_MODOS 5
+// Estado de la trayectoria en flash (MODO 4) y su periodo de muestreo
+#define FLASH_TICKS 2           // Una muestra cada 100 ms, hasta 2.5 min de movimiento
+#define FLASH_LIBRE 0
+#define FLASH_GRABANDO 1
+#define FLASH_REPRODUCIENDO 2
+// Trayectorias largas (MODO 4) en la memoria de programa, escrita por el
+// propio PIC con EEPGD = 1. El rango FLASH_INICIO - FLASH_FIN queda fuera del
+// enlazador (code-model-rom del proyecto). Cada muestra son dos palabras de
+// 14 bits con 7 bits por articulacin: {POT_1, POT_2} y {POT_3, POT_4}
+#define FLASH_INICIO 0x1400
+#define FLASH_FIN 0x2000
+#define FLASH_BLOQUE 4          // Palabras por escritura; la de EEADR<1:0> = 11 borra y escribe el bloque
+#define FLASH_PALABRAS_MUESTRA 2
+#define FLASH_MAX ((FLASH_FIN - FLASH_INICIO)/FLASH_PALABRAS_MUESTRA)     // 1536 muestras
+#define FLASH_MAGICO 0xF1
+#define COMPRIMIR_7(p) ((p) >> 1)
+#define EXPANDIR_7(v) ((uint8_t)(((v) << 1) | ((v) >> 6)))    // 0 -> 0, 127 -> 255
+
+/*------------------------------------------------------------------------------
+ * VARIABLES 
+ ------------------------------------------------------------------------------*/
+struct DUTY {                               // Ciclo de trabajo listo para CCP
+    uint8_t CCPRL;                          // 8 bits mas significativos
+    uint8_t DCB;                            // 2 bits menos significativos (bits 5:4)
+};
+
+struct SALUD_ESCLAVO {                      // Se actualiza al cerrar cada trama
+    uint8_t CONTADOR;                       // CONTADOR de la ltima respuesta vlida
+    uint8_t FALLOS;                         // Respuestas invlidas seguidas (0 = responde)
+    uint8_t ERRORES;                        // Respuestas con ESTADO distinto de 0
+    uint8_t PERDIDAS;                       // Tramas que el esclavo no cont
+    uint8_t RETRASO;                        // Tramas seguidas sin aplicar lo ltimo enviado
+    uint8_t RETRASO_MAX;
+    uint8_t TRAMAS;                         // Tramas completas (vuelve a 0 tras 255)
+    uint8_t POS[CANALES_ESCLAVO];           // Posicin que el esclavo dice tener
+    uint8_t ENVIADO[CANALES_ESCLAVO];       // Posicin enviada en la trama anterior
+};
+
+extern uint8_t MODO;
+extern uint8_t POT_1;
+extern uint8_t POT_2;
+extern uint8_t POT_3;
+extern uint8_t POT_4;
+extern uint8_t POT_1_E;
+extern uint8_t POT_2_E;
+extern uint8_t POT_3_E;
+extern uint8_t POT_4_E;
+extern uint8_t BANDERA_L1, BANDERA_L2;
+extern uint8_t BANDERA_E1, BANDERA_E2;
+extern uint8_t BANDERA_R;
+extern uint8_t VALORPOT_USART;
+extern uint8_t TICKS;
+extern uint8_t PASO;
+extern uint8_t BANDERA_USART;
+extern uint8_t VALOR_USART;
+extern uint8_t BANDERA_MODO2A0;
+extern char VALORES[2];
+
+extern const struct DUTY TABLA_POT[256];
+
+extern uint8_t SPI_TURNO;
+extern uint8_t BANDERA_LATCH;
+extern uint8_t LATCH_ALTO;
+extern struct DUTY CCP_ESPERA[2];
+extern uint8_t TICKS_SPI;
+extern uint8_t SPI_POS[N_ESCLAVOS][CANALES_ESCLAVO];
+extern uint8_t SPI_PENDIENTE[N_ESCLAVOS];
+#if N_ESCLAVOS > 1
+extern uint8_t EXTRA_CANAL[EXTRA_TAM];
+extern uint8_t EXTRA_POS[EXTRA_TAM];
+extern volatile uint8_t EXTRA_INICIO;
+extern volatile uint8_t EXTRA_FIN;
+#endif
+extern uint8_t SPI_TRAMA[SPI_TRAMA_MAX];
+extern uint8_t SPI_LEN;
+extern uint8_t SPI_N;
+extern uint8_t SPI_ESCLAVO;
+extern uint8_t SPI_OCUPADO;
+extern uint8_t DATO_SPI;
+extern uint8_t I2C_ESTADO;
+extern uint8_t SPI_RESPUESTA[SPI_RESPUESTA_LEN];
+
+extern struct SALUD_ESCLAVO SALUD[N_ESCLAVOS];
+
+extern uint8_t RX_BUFFER[RX_TAM];
+extern volatile uint8_t RX_INICIO;
+extern volatile uint8_t RX_FIN;
+extern uint8_t ERRORES_OERR;
+extern uint8_t ERRORES_FERR;
+extern uint8_t ERRORES_RX;
+extern uint8_t ERRORES_TRAMA;
+
+extern uint8_t TRAMA_ESTADO;
+extern uint8_t TRAMA_CMD;
+extern uint8_t TRAMA_LEN;
+extern uint8_t TRAMA_N;
+extern uint8_t TRAMA_CRC;
+extern uint8_t TRAMA_DATOS[TRAMA_MAX];
+
+extern uint16_t VELOCIDAD[N_SERVOS];
+extern uint8_t ACELERACION[N_SERVOS];
+extern uint16_t VEL_ACTUAL[N_SERVOS];
+extern uint8_t AVANCE[N_SERVOS];
+
+extern uint8_t TELEMETRIA_PERIODO;
+extern uint8_t TICKS_TELEMETRIA;
+extern uint8_t BANDERA_TELEMETRIA;
+extern uint8_t SEC_TELEMETRIA;
+
+extern uint16_t TRAY_TIEMPO[TRAY_TAM];
+extern uint8_t TRAY_POS[TRAY_TAM][N_SERVOS];
+extern volatile uint8_t TRAY_INICIO;
+extern volatile uint8_t TRAY_FIN;
+extern volatile uint8_t TRAY_DESCARTAR;
+extern uint16_t TRAY_RELOJ;
+extern uint8_t TRAY_ACTIVA;
+extern uint8_t TRAY_VACIA;
+
+extern uint8_t TX_BUFFER[TX_TAM];
+extern volatile uint8_t TX_INICIO;
+extern volatile uint8_t TX_FIN;
+extern uint8_t TX_MAX;
+
+extern uint8_t LOG_VALOR[LOG_CLAVES][4];
+extern uint8_t LOG_RANURA[LOG_CLAVES];
+extern uint8_t LOG_CABEZA;
+extern uint8_t LOG_SEC;
+extern uint8_t BANDERA_ESTADO;
+
+extern uint8_t SEC_CUENTA;
+extern uint8_t SEC_INDICE;
+extern uint8_t SEC_NUEVA;
+extern volatile uint8_t SEC_REPRODUCIENDO;
+extern volatile uint8_t SEC_ESPERA;
+extern volatile uint8_t SEC_TICKS;
+extern uint8_t BANDERA_SEC_G, BANDERA_SEC_R;
+extern uint8_t BANDERA_SEC_SIG;
+
+extern volatile uint8_t FLASH_ESTADO;
+extern uint8_t TICKS_MUESTRA;
+extern uint8_t BANDERA_MUESTRA;
+extern uint8_t BANDERA_FLASH_G, BANDERA_FLASH_R;
+extern uint16_t FLASH_BUFFER[FLASH_BLOQUE];
+extern uint8_t FLASH_LLENAS;
+extern uint16_t FLASH_CUENTA;
+extern uint16_t FLASH_INDICE;
+extern uint8_t BANDERA_CUENTA;
+
+extern const uint8_t LEDS_MODO[N_MODOS];
+
+/*------------------------------------------------------------------------------
+ * PROTOTIPO DE FUNCIONES 
+ ------------------------------------------------------------------------------*/
+// Capa de hardware: EEPROM de datos, memoria de programa y bus I2C del PIC o
+// su simulacin
+void ESCRITURA_EEPROM(uint8_t DIRECCION, uint8_t DATA);
+uint8_t LECTURA_EEPROM(uint8_t DIRECCION);
+void FLASH_ESCRIBIR_BLOQUE(uint16_t DIRECCION, const uint16_t *PALABRAS);
+uint16_t FLASH_LEER(uint16_t DIRECCION);
+void I2C_LIBERAR(void);
+// Ncleo
+void NUCLEO_INICIAR(void);
+void NUCLEO_PRINCIPAL(void);
+void FLASH_GRABAR_MUESTRA(void);
+void FLASH_LEER_MUESTRA(void);
+void FLASH_DETENER(void);
+void LOG_RECUPERAR(void);
+void LOG_ESCRIBIR(uint8_t CLAVE, const uint8_t *DATOS);
+uint8_t LOG_VIGENTE(uint8_t RANURA);
+void GUARDAR_ESTADO(void);
+void GUARDAR_POSE(uint8_t N);
+void CARGAR_POSE(uint8_t N);
+void LEER_SECUENCIA(void);
+void GRABAR_REGISTRO(void);
+uint8_t CARGAR_REGISTRO(uint8_t I);
+uint8_t CRC8(uint8_t CRC, uint8_t DATO);
+uint8_t LOG_VALIDA(uint8_t RANURA);
+void SPI_PREPARAR(uint8_t ESCLAVO, uint8_t CANAL, uint8_t VALOR);
+uint8_t SPI_TRANSMITIR(uint8_t ESCLAVO);
+void SPI_SIGUIENTE(void);
+void I2C_COLISION(void);
+void I2C_INVALIDAR(void);
+void PROCESAR_USART(void);
+uint8_t uart_write(const uint8_t *DATOS, uint8_t N);
+void EJECUTAR_TRAMA(void);
+uint8_t ENVIAR_TRAMA(uint8_t CMD, const uint8_t *DATOS, uint8_t LEN);
+uint8_t INICIAR_TRAMA(uint8_t DATO);
+void EJECUTAR_POLOLU(void);
+void FIJAR_OBJETIVO(uint8_t CANAL, uint8_t POSICION);
+uint8_t POSICION_ACTUAL(uint8_t CANAL);
+uint8_t EN_MOVIMIENTO(void);
+void ENVIAR_TELEMETRIA(void);
+uint8_t ENCOLAR_PUNTO(void);
+uint8_t TRAY_LIBRES(void);
+void NUCLEO_BOTONES(uint8_t BOTONES);
+void NUCLEO_TICK(void);
+void NUCLEO_MUESTREO(void);
+void NUCLEO_PERIODO_PWM(void);
+void NUCLEO_TRAYECTORIA(void);
+void NUCLEO_ADC(uint8_t CANAL, uint8_t MUESTRA);
+uint8_t ACERCAR(uint8_t ACTUAL, uint8_t OBJETIVO, uint8_t CANAL);
+
+#endif
@@ -0,0 +1,102 @@
+#!/bin/sh
+#
+# File:   presupuesto.sh
+# Reporte de memoria por funcion a partir del .map, .lst y memoryfile.xml que
+# genera XC8. Falla (codigo 1) si se excede alguno de los presupuestos.
+#
+# Uso: sh presupuesto.sh [directorio de dist]
+#   PRESUPUESTO_FLASH   palabras de programa permitidas (de 5120, 0x1400 - 0x1FFF
+#                       queda reservado para las trayectorias en flash)
+#   PRESUPUESTO_RAM     bytes de RAM permitidos (de 368)
+#   PRESUPUESTO_PILA    niveles de pila permitidos (de 8)
+#
+
+DIST=${1:-dist/default/production}
+MAP=$DIST/Maestro.X.production.map
+LST=$DIST/Maestro.X.production.lst
+XML=$DIST/memoryfile.xml
+
+PRESUPUESTO_FLASH=${PRESUPUESTO_FLASH:-4608}
+PRESUPUESTO_RAM=${PRESUPUESTO_RAM:-320}
+PRESUPUESTO_PILA=${PRESUPUESTO_PILA:-7}
+
+for f in "$MAP" "$LST" "$XML"; do
+    if [ ! -f "$f" ]; then
+        echo "presupuesto: no existe $f" >&2
+        exit 1
+    fi
+done
+
+awk -v flash="$PRESUPUESTO_FLASH" -v ram="$PRESUPUESTO_RAM" -v pila="$PRESUPUESTO_PILA" '
+    { sub(/\r$/, "") }
+
+    # memoryfile.xml: totales de programa y datos
+    FILENAME ~ /\.xml$/ {
+        if ($0 ~ /<memory name="program">/) mem = "programa"
+        if ($0 ~ /<memory name="data">/) mem = "datos"
+        if ($0 ~ /<used>/) { gsub(/[^0-9]/, ""); usado[mem] = $0 + 0 }
+        if ($0 ~ /<length>/) { gsub(/[^0-9]/, ""); total[mem] = $0 + 0 }
+        next
+    }
+
+    # .map, MODULE INFORMATION: palabras de programa por funcion
+    FILENAME ~ /\.map$/ {
+        if ($0 ~ /^MODULE INFORMATION/) { modulos = 1; next }
+        if (modulos && NF == 5 && $2 == "CODE") {
+            palabras[$1] = $5
+            orden[++n] = $1
+        }
+        next
+    }
+
+    # .lst, tablas del grafo de llamadas: RAM y profundidad por funcion
+    /^ \([0-9]+\) [^ ]+ +[0-9]+ +[0-9]+ +[0-9]+ +[0-9]+$/ {
+        prof = $1; gsub(/[()]/, "", prof)
+        nivel[$2] = prof + 0
+        ram_f[$2] = $3
+        next
+    }
+    /Estimated maximum stack depth/ {
+        if ($NF + 0 > pila_max) pila_max = $NF + 0
+        next
+    }
+    # .lst, espacios de direcciones: RAM usada por banco (hexadecimal)
+    /^BANK[0-3] +[0-9A-F]+ +[0-9A-F]+ +[0-9A-F]+ / {
+        banco[$1] = $4
+        next
+    }
+
+    function hex(h,    i, v) {
+        v = 0
+        for (i = 1; i <= length(h); i++)
+            v = v * 16 + index("0123456789ABCDEF", substr(h, i, 1)) - 1
+        return v
+    }
+
+    END {
+        printf "%-24s %8s %6s %6s\n", "Funcion", "Palabras", "RAM", "Nivel"
+        for (i = 1; i <= n; i++) {
+            f = orden[i]
+            printf "%-24s %8d %6s %6s\n", f, palabras[f], \
+                (f in ram_f) ? ram_f[f] : "-", (f in nivel) ? nivel[f] : "-"
+            if (f ~ /^___fl|tofl$|^___ft/) flotantes = flotantes " " f
+            if (f ~ /^i1/) duplicadas = duplicadas " " f
+        }
+        printf "\n"
+        for (b = 0; b <= 3; b++)
+            printf "BANK%d: %d bytes\n", b, hex(banco["BANK" b])
+        printf "Programa: %d/%d palabras (presupuesto %d)\n", usado["programa"], total["programa"], flash
+        printf "RAM: %d/%d bytes (presupuesto %d)\n", usado["datos"], total["datos"], ram
+        printf "Pila: %d/8 niveles (presupuesto %d)\n", pila_max, pila
+
+        if (flotantes != "") printf "AVISO: libreria de flotantes enlazada:%s\n", flotantes
+        if (duplicadas != "") printf "AVISO: funciones duplicadas para isr():%s\n", duplicadas
+        if (pila_max >= 7) printf "AVISO: la pila de hardware esta cerca de sus 8 niveles\n"
+
+        error = 0
+        if (usado["programa"] > flash) { printf "ERROR: programa excede el presupuesto\n"; error = 1 }
+        if (usado["datos"] > ram) { printf "ERROR: RAM excede el presupuesto\n"; error = 1 }
+        if (pila_max > pila) { printf "ERROR: pila excede el presupuesto\n"; error = 1 }
+        exit error
+    }
+' "$XML" "$MAP" "$LST"
@@ -0,0 +1,107 @@
+/*
+ * File:   hw_sim.h
+ * Capa de hardware simulada: reemplaza a hw.h para compilar nucleo.c con gcc
+ * (make simulacion). Las macros HW_* escriben en los registros y perifricos
+ * de perifericos.c en lugar de los del PIC16F887
+ */
+
+#ifndef HW_SIM_H
+#define HW_SIM_H
+
+#include <stdint.h>
+
+#define DCB_MASK 0b00110000     // Bits DCxB dentro de CCP1CON/CCP2CON
+
+/*------------------------------------------------------------------------------
+ * REGISTROS SIMULADOS
+ ------------------------------------------------------------------------------*/
+extern uint8_t CCPR1L, CCP1CON, CCPR2L, CCP2CON;
+extern uint8_t SIM_LATCH;                   // Lnea LATCH compartida con los esclavos
+extern uint8_t SIM_TXIE;                    // PIE1bits.TXIE
+extern uint8_t SIM_GIE;                     // INTCONbits.GIE (di/ei)
+extern uint8_t SIM_LEDS;                    // PORTE: LEDs del modo
+
+extern uint8_t SIM_I2C_NACK;                // SSPCON2bits.ACKSTAT
+extern uint8_t SIM_BCLIF;                   // PIR2bits.BCLIF
+extern int16_t SIM_I2C_COLISION;            // Bytes antes de una colisin en el bus (-1 nunca)
+extern uint8_t SIM_I2C_LIBERACIONES;        // Llamadas a I2C_LIBERAR
+
+void SIM_SPI_ENVIAR(uint8_t DATO);
+void SIM_SPI_CS(uint8_t ESCLAVO, uint8_t NIVEL);
+void SIM_I2C_ENVIAR(uint8_t DATO);
+void SIM_I2C_CONDICION(uint8_t PARADA);
+void SIM_I2C_RECIBIR(void);
+void SIM_I2C_ACK(uint8_t NACK);
+
+/*------------------------------------------------------------------------------
+ * CAPA DE HARDWARE
+ ------------------------------------------------------------------------------*/
+#define HW_CCP1(d)          do{ CCPR1L = (d).CCPRL; CCP1CON = (CCP1CON & ~DCB_MASK) | (d).DCB; }while(0)
+#define HW_CCP2(d)          do{ CCPR2L = (d).CCPRL; CCP2CON = (CCP2CON & ~DCB_MASK) | (d).DCB; }while(0)
+#define HW_LATCH(v)         (SIM_LATCH = (v))
+#if TRANSPORTE_I2C
+#define HW_SPI_ENVIAR(v)    SIM_I2C_ENVIAR(v)
+#else
+#define HW_SPI_ENVIAR(v)    SIM_SPI_ENVIAR(v)
+#endif
+#define HW_SPI_CS(e, nivel) SIM_SPI_CS(e, nivel)
+#define HW_I2C_INICIO()     SIM_I2C_CONDICION(0)
+#define HW_I2C_REINICIO()   SIM_I2C_CONDICION(0)
+#define HW_I2C_PARADA()     SIM_I2C_CONDICION(1)
+#define HW_I2C_RECIBIR()    SIM_I2C_RECIBIR()
+#define HW_I2C_ACK(nack)    SIM_I2C_ACK(nack)
+#define HW_I2C_NACK()       SIM_I2C_NACK
+#define HW_TX_ACTIVAR()     (SIM_TXIE = 1)
+#define HW_LEDS(v)          (SIM_LEDS = (v))
+#define di()                (SIM_GIE = 0)
+#define ei()                (SIM_GIE = 1)
+
+/*------------------------------------------------------------------------------
+ * PERIFRICOS
+ * Un periodo de TMR0 (2 ms) del firmware: el mismo orden de llamadas que
+ * isr() para TMR0, ADC, MSSP, TMR2, TMR1 y TXIF
+ ------------------------------------------------------------------------------*/
+#define SIM_PERIODOS_TICK 25    // TMR1 de 50 ms en periodos de TMR0
+#define SIM_PERIODOS_PWM 2      // TMR2 de 4 ms en periodos de TMR0
+#define SIM_TX_TAM 256
+// Duracin de un bit en el bus: SPI a Fosc/4 (250 kHz) o I2C a 83 kHz
+// (I2C_SSPADD 2). Inicio, reinicio, parada y ACK cuentan como un bit
+#if TRANSPORTE_I2C
+#define SIM_US_BIT 12
+#else
+#define SIM_US_BIT 4
+#endif
+
+struct ESCLAVO_SIM {                        // Placa esclava en el bus
+    uint8_t PRESENTE;                       // 0 -> MISO queda en 1 (sin respuesta)
+    uint8_t CONTADOR;                       // Tramas vlidas recibidas
+    uint8_t ESTADO;                         // 1 si la ltima trama tena mala SUMA
+    uint8_t POS[CANALES_ESCLAVO];           // Posicin aplicada a sus CCP
+    uint8_t ESPERA[CANALES_ESCLAVO];        // Posicin recibida, pendiente del latch
+    uint8_t RX[SPI_TRAMA_MAX];              // Bytes recibidos en la ventana de CS
+    uint8_t N;
+    uint8_t RESPUESTA[SPI_RESPUESTA_LEN];   // Lo que devuelve por MISO
+    uint8_t K;
+    uint16_t TRAMAS;                        // Ventanas de chip-select completas
+};
+extern struct ESCLAVO_SIM ESCLAVOS_SIM[N_ESCLAVOS];
+
+extern uint8_t SIM_ADC[4];                  // Muestra de 8 bits de AN0 - AN3
+extern uint8_t SIM_EEPROM[256];
+extern uint16_t SIM_EE_ESCRITURAS;          // Bytes escritos en la EEPROM
+extern int16_t SIM_EE_CORTE;                // Escrituras antes de perder la energa (-1 nunca)
+extern uint16_t SIM_FLASH[FLASH_FIN - FLASH_INICIO];   // Regin de trayectorias de la memoria de programa
+extern uint16_t SIM_FLASH_BLOQUES;          // Bloques escritos en la flash
+extern uint8_t SIM_TX[SIM_TX_TAM];          // Bytes que salieron por TX
+extern uint16_t SIM_TX_N;
+extern uint32_t SIM_BYTES_MSSP;             // Bytes transferidos por el MSSP
+extern uint32_t SIM_EVENTOS_MSSP;           // SSPIF: una entrada a isr() cada uno
+extern uint32_t SIM_BITS_BUS;               // Bits de reloj en SCK o SCL
+extern uint32_t SIM_PERIODO;                // Periodos de TMR0 simulados
+
+void SIM_REINICIAR(void);
+void SIM_CORRER(uint16_t PERIODOS);
+void SIM_RECIBIR(const uint8_t *DATOS, uint8_t N);
+uint16_t SIM_DUTY(uint8_t CCP);
+
+#endif
@@ -0,0 +1,214 @@
+#!/usr/bin/env python3
+# Banco de tiempos del ISR con gpsim. Agrega a medir_isr.stc los estímulos de
+# los botones (RB0/RB1) y de la USART (RC7 a 9600 baudios), corre el .hex
+# compilado con MEDIR_ISR = 1 y resume el registro de escrituras:
+#   make medir_isr                      (compila con MEDIR_ISR y corre esto)
+#   python3 simulacion/medir_isr.py --segundos 4
+# Con TRANSPORTE_I2C compilado en 1 se pasa --i2c para contar las tramas por
+# las escrituras en SSPBUF de I2C (sin esclavo en gpsim la dirección no tiene
+# ACK y cada trama se corta tras su primer byte)
+# Imprime ciclos por ruta del ISR (marcas RD4 - RD7), latencia de los botones
+# y de la USART, y la tasa de escrituras en CCP1/CCP2, SSPBUF y TXREG.
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+FCY = 250000                    # Ciclos de instrucción por segundo (Fosc/4)
+BAUDIOS = 9600
+SPI_BYTES_TRAMA = 5             # SPI_RESPUESTA_LEN con CANALES_ESCLAVO = 2
+I2C_BYTES_TRAMA = 6             # 2 direcciones y el cuerpo; lo leído no pasa por SSPBUF
+DIR_SALIDA = 'build/simulacion'
+
+# Ruta -> bit de PORTD que la marca
+MARCAS = {'isr': 7, 'PORTB': 6, 'ADC': 5, 'USART': 4}
+
+TRAMA_SYNC = 0xA5
+CMD_CONSULTA = 0x03
+CMD_TELEMETRIA = 0x04
+POLOLU_OBJETIVO = 0x84
+
+
+def crc8(crc, dato):
+    # CRC-8, polinomio 0x07, igual que CRC8() del firmware
+    crc ^= dato
+    for _ in range(8):
+        crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def trama(cmd, datos):
+    crc = crc8(crc8(0, cmd), len(datos))
+    for dato in datos:
+        crc = crc8(crc, dato)
+    return bytes([TRAMA_SYNC, cmd, len(datos)]) + bytes(datos) + bytes([crc])
+
+
+def flancos_usart(datos, inicio, pausa):
+    # Flancos de RC7 para 8N1: bit de inicio en 0, datos LSB primero, parada
+    # en 1. Devuelve los flancos y el ciclo en que el EUSART termina cada byte
+    bit = FCY / BAUDIOS
+    flancos = []
+    fin_bytes = []
+    t = inicio
+    for dato in datos:
+        bits = [0] + [(dato >> i) & 1 for i in range(8)] + [1]
+        nivel = 1
+        for i, b in enumerate(bits):
+            if b != nivel:
+                flancos.append((int(t + i*bit), b))
+                nivel = b
+        fin_bytes.append(int(t + 9.5*bit))  # Muestra del bit de parada: RCIF
+        t += 10*bit + pausa
+    return flancos, fin_bytes
+
+
+def estimulo(nombre, pin, inicial, flancos):
+    lineas = ['stimulus asynchronous_stimulus',
+              'initial_state %d' % inicial,
+              'start_cycle 0',
+              'period 0',
+              '{ ' + ',\n  '.join('%d, %d' % f for f in flancos) + ' }',
+              'name %s' % nombre,
+              'end',
+              'node n_%s' % nombre,
+              'attach n_%s %s %s' % (nombre, nombre, pin)]
+    return '\n'.join(lineas)
+
+
+def escribir_script(base, segundos):
+    # Botones: RB1 guarda la pose a 1 s, RB0 cambia de modo a 1.5 s (200 ms
+    # presionados). USART: una consulta, la telemetría a 50 Hz (a 9600 baudios
+    # caben ~68 tramas/s) y una ráfaga de objetivos Pololu sin pausa entre bytes
+    rb1 = [(FCY, 0), (FCY + FCY//5, 1)]
+    rb0 = [(FCY*3//2, 0), (FCY*3//2 + FCY//5, 1)]
+    datos = trama(CMD_CONSULTA, []) + trama(CMD_TELEMETRIA, [10])
+    for canal in range(4):
+        datos += bytes([POLOLU_OBJETIVO, canal, 0x70, 0x2E])
+    rx, fin_bytes = flancos_usart(datos, FCY*2, 0)
+    script = open(base, encoding='latin-1').read()
+    script += '\n'.join(['',
+                         estimulo('rb1', 'portb1', 1, rb1),
+                         estimulo('rb0', 'portb0', 1, rb0),
+                         estimulo('rx', 'portc7', 1, rx),
+                         'break c %d' % int(segundos*FCY),
+                         'run',
+                         'log off',
+                         'quit',
+                         ''])
+    ruta = os.path.join(DIR_SALIDA, 'medir_isr_corrida.stc')
+    with open(ruta, 'w') as f:
+        f.write(script)
+    bordes = [t for t, nivel in rb1 + rb0 if nivel == 0]
+    return ruta, bordes, fin_bytes
+
+
+def leer_registro(ruta):
+    # Cada escritura del registro de gpsim trae el ciclo, el valor escrito y
+    # el registro: "0x...  p16f887 ... wrote: 0x80 to portd(0x0008) ..."
+    patron = re.compile(r'^\s*(0x[0-9a-f]+|\d+)\b.*?wr\w*:?\s*(0x[0-9a-f]+)\s+to\s+(\w+)', re.I)
+    escrituras = []
+    with open(ruta, errors='replace') as f:
+        for linea in f:
+            m = patron.search(linea)
+            if m:
+                escrituras.append((int(m.group(1), 0), int(m.group(2), 16), m.group(3).lower()))
+    return escrituras
+
+
+def intervalos(escrituras, bit):
+    # Intervalos (subida, bajada) del bit de PORTD
+    alto = None
+    previo = 0
+    for ciclo, valor, registro in escrituras:
+        if registro != 'portd':
+            continue
+        nivel = (valor >> bit) & 1
+        if nivel and not (previo >> bit) & 1:
+            alto = ciclo
+        elif not nivel and alto is not None:
+            yield alto, ciclo
+            alto = None
+        previo = valor
+
+
+def resumen(nombre, duraciones):
+    if not duraciones:
+        print('%-8s %6d' % (nombre, 0))
+        return
+    prom = sum(duraciones) / len(duraciones)
+    print('%-8s %6d %7d %7.1f %7d %9.0f' % (nombre, len(duraciones), min(duraciones),
+                                            prom, max(duraciones), max(duraciones)*4))
+
+
+def latencias(eventos, subidas):
+    resultado = []
+    for t in eventos:
+        siguientes = [s for s in subidas if s >= t]
+        if siguientes:
+            resultado.append(siguientes[0] - t)
+    return resultado
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Ciclos por ruta del ISR en gpsim')
+    parser.add_argument('--segundos', type=float, default=4.0)
+    parser.add_argument('--script', default='simulacion/medir_isr.stc')
+    parser.add_argument('--gpsim', default='gpsim')
+    parser.add_argument('--i2c', action='store_true', help='firmware con TRANSPORTE_I2C = 1')
+    args = parser.parse_args()
+
+    os.makedirs(DIR_SALIDA, exist_ok=True)
+    script, bordes, fin_bytes = escribir_script(args.script, args.segundos)
+    registro = os.path.join(DIR_SALIDA, 'medir_isr.log')
+    if os.path.exists(registro):
+        os.remove(registro)
+    try:
+        subprocess.run([args.gpsim, '-i', '-c', script], check=True,
+                       stdout=subprocess.DEVNULL)
+    except FileNotFoundError:
+        sys.exit('medir_isr: no se encontró %s' % args.gpsim)
+    escrituras = leer_registro(registro)
+    if not escrituras:
+        sys.exit('medir_isr: el registro %s no tiene escrituras' % registro)
+    total = args.segundos * FCY
+
+    rutas = {nombre: list(intervalos(escrituras, bit)) for nombre, bit in MARCAS.items()}
+    print('ruta          n     min    prom     max  max (us)   [ciclos de 4 us]')
+    for nombre in MARCAS:
+        resumen(nombre, [b - a for a, b in rutas[nombre]])
+    # Interrupciones sin ruta marcada: TMR0, TMR1, TMR2, MSSP, EEPROM y TX
+    marcadas = [a for nombre in ('PORTB', 'ADC', 'USART') for a, _ in rutas[nombre]]
+    otras = [b - a for a, b in rutas['isr'] if not any(a <= m <= b for m in marcadas)]
+    resumen('otras', otras)
+    ocupado = sum(b - a for a, b in rutas['isr'])
+    print('CPU en isr(): %.1f %%' % (100.0 * ocupado / total))
+
+    # Latencia: del evento a la marca de su ruta. Incluye el guardado de
+    # contexto y la espera por otra interrupción que ya se estaba atendiendo
+    subidas_b = [a for a, _ in rutas['PORTB']]
+    subidas_u = [a for a, _ in rutas['USART']]
+    for nombre, valores in (('RB', latencias(bordes, subidas_b)),
+                            ('RCIF', latencias(fin_bytes, subidas_u))):
+        if valores:
+            print('latencia %-4s: max %d ciclos (%d us), prom %.1f' %
+                  (nombre, max(valores), max(valores)*4, sum(valores)/len(valores)))
+    print('latencia peor caso estimada: %d ciclos (isr más larga)' %
+          max(b - a for a, b in rutas['isr']))
+
+    cuenta = {}
+    for _, _, registro_escrito in escrituras:
+        cuenta[registro_escrito] = cuenta.get(registro_escrito, 0) + 1
+    segundos = args.segundos
+    print('CCP1: %.0f escrituras/s, CCP2: %.0f escrituras/s' %
+          (cuenta.get('ccpr1l', 0) / segundos, cuenta.get('ccpr2l', 0) / segundos))
+    por_trama = I2C_BYTES_TRAMA if args.i2c else SPI_BYTES_TRAMA
+    print('MSSP: %.0f escrituras/s, ~%.0f tramas/s' %
+          (cuenta.get('sspbuf', 0) / segundos, cuenta.get('sspbuf', 0) / por_trama / segundos))
+    print('TX:   %.0f bytes/s' % (cuenta.get('txreg', 0) / segundos))
+
+
+if __name__ == '__main__':
+    main()
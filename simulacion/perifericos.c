@@ -0,0 +1,385 @@
+/*
+ * File:   perifericos.c
+ * Perifricos simulados del PIC16F887 para correr nucleo.c en la PC: ADC,
+ * CCP, MSSP con sus esclavos, EUSART, EEPROM de datos y la regin de
+ * trayectorias de la memoria de programa. SIM_CORRER avanza el tiempo en
+ * periodos de TMR0 y llama al ncleo como lo hace isr()
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "../nucleo.h"
+#include "hw_sim.h"
+
+/*------------------------------------------------------------------------------
+ * VARIABLES
+ ------------------------------------------------------------------------------*/
+uint8_t CCPR1L, CCP1CON, CCPR2L, CCP2CON;
+uint8_t SIM_LATCH;
+uint8_t SIM_TXIE;
+uint8_t SIM_GIE = 1;
+uint8_t SIM_LEDS;
+
+struct ESCLAVO_SIM ESCLAVOS_SIM[N_ESCLAVOS];
+uint8_t SIM_CS = 0xFF;                      // Esclavo seleccionado (0xFF ninguno)
+uint8_t SIM_SSPBUF;
+uint8_t SIM_SSPIF;
+uint8_t SIM_I2C_NACK;
+uint8_t SIM_I2C_DIR = 0xFF;                 // Esclavo direccionado (0xFF ninguno)
+uint8_t SIM_I2C_DIRECCION;                  // El prximo byte es la direccin
+uint8_t SIM_BCLIF;
+int16_t SIM_I2C_COLISION = -1;
+uint8_t SIM_I2C_LIBERACIONES;
+
+uint8_t SIM_ADC[4];
+uint8_t SIM_CANAL_ADC;                      // ADCON0bits.CHS
+uint8_t SIM_EEPROM[256];
+uint16_t SIM_EE_ESCRITURAS;
+int16_t SIM_EE_CORTE = -1;
+uint16_t SIM_FLASH[FLASH_FIN - FLASH_INICIO];
+uint16_t SIM_FLASH_BLOQUES;
+uint8_t SIM_TX[SIM_TX_TAM];
+uint16_t SIM_TX_N;
+uint32_t SIM_BYTES_MSSP;
+uint32_t SIM_EVENTOS_MSSP;
+uint32_t SIM_BITS_BUS;
+uint32_t SIM_PERIODO;
+
+/*------------------------------------------------------------------------------
+ * PROTOTIPO DE FUNCIONES
+ ------------------------------------------------------------------------------*/
+void ESCLAVO_RESPUESTA(struct ESCLAVO_SIM *E);
+void ESCLAVO_TRAMA(struct ESCLAVO_SIM *E);
+void SIM_MSSP(void);
+void SIM_EUSART(void);
+
+/*------------------------------------------------------------------------------
+ * FUNCIONES
+ ------------------------------------------------------------------------------*/
+// Perifricos en su estado de reset, EEPROM borrada y esclavos conectados
+void SIM_REINICIAR(void){
+    uint16_t I;
+    uint8_t E;
+    memset(SIM_EEPROM, 0xFF, sizeof(SIM_EEPROM));
+    for(I = 0; I < FLASH_FIN - FLASH_INICIO; I++){
+        SIM_FLASH[I] = 0x3FFF;              // Memoria de programa borrada
+    }
+    memset(ESCLAVOS_SIM, 0, sizeof(ESCLAVOS_SIM));
+    for(E = 0; E < N_ESCLAVOS; E++){
+        ESCLAVOS_SIM[E].PRESENTE = 1;
+        ESCLAVO_RESPUESTA(&ESCLAVOS_SIM[E]);
+    }
+    SIM_EE_ESCRITURAS = 0;
+    SIM_EE_CORTE = -1;
+    SIM_FLASH_BLOQUES = 0;
+    SIM_TX_N = 0;
+    SIM_BYTES_MSSP = 0;
+    SIM_EVENTOS_MSSP = 0;
+    SIM_BITS_BUS = 0;
+    SIM_I2C_DIR = 0xFF;
+    SIM_I2C_COLISION = -1;
+    SIM_I2C_LIBERACIONES = 0;
+    SIM_BCLIF = 0;
+    SIM_PERIODO = 0;
+    SIM_CANAL_ADC = 0;
+}
+
+// Avanza PERIODOS de TMR0 (2 ms cada uno)
+void SIM_CORRER(uint16_t PERIODOS){
+    uint8_t E;
+    uint8_t LATCH_PREVIO;
+    while(PERIODOS--){
+        SIM_PERIODO++;
+        NUCLEO_MUESTREO();                  // T0IF
+        SIM_MSSP();
+        NUCLEO_ADC(SIM_CANAL_ADC, SIM_ADC[SIM_CANAL_ADC]);     // ADIF
+        SIM_CANAL_ADC = (SIM_CANAL_ADC + 1) & 0b11;
+        if(SIM_PERIODO % SIM_PERIODOS_PWM == 0){
+            LATCH_PREVIO = SIM_LATCH;
+#if LATCH_SIMULTANEO
+            NUCLEO_PERIODO_PWM();           // TMR2IF
+#endif
+            if(SIM_LATCH && !LATCH_PREVIO){ // Flanco de subida: los esclavos aplican
+                for(E = 0; E < N_ESCLAVOS; E++){
+                    memcpy(ESCLAVOS_SIM[E].POS, ESCLAVOS_SIM[E].ESPERA, CANALES_ESCLAVO);
+                    ESCLAVO_RESPUESTA(&ESCLAVOS_SIM[E]);
+                }
+            }
+        }
+        if(SIM_PERIODO % SIM_PERIODOS_TICK == 0){
+            NUCLEO_TICK();                  // TMR1IF
+        }
+        SIM_EUSART();
+    }
+}
+
+// Bytes que llegan por RX, como los guarda isr() en el buffer circular
+void SIM_RECIBIR(const uint8_t *DATOS, uint8_t N){
+    while(N--){
+        if(((RX_FIN + 1) & RX_MASK) == RX_INICIO){
+            ERRORES_RX++;
+        }
+        else{
+            RX_BUFFER[RX_FIN] = *DATOS;
+            RX_FIN = (RX_FIN + 1) & RX_MASK;
+        }
+        DATOS++;
+    }
+}
+
+// Ciclo de trabajo cargado en CCP1 o CCP2, en cuentas de 4 us
+uint16_t SIM_DUTY(uint8_t CCP){
+    if(CCP == 1){
+        return ((uint16_t)CCPR1L << 2) | ((CCP1CON & DCB_MASK) >> 4);
+    }
+    return ((uint16_t)CCPR2L << 2) | ((CCP2CON & DCB_MASK) >> 4);
+}
+
+// TXIF: mientras TXIE est en 1 el EUSART vaca el buffer de transmisin
+void SIM_EUSART(void){
+    while(SIM_TXIE){
+        if(TX_INICIO == TX_FIN){
+            SIM_TXIE = 0;
+            break;
+        }
+        if(SIM_TX_N < SIM_TX_TAM){
+            SIM_TX[SIM_TX_N++] = TX_BUFFER[TX_INICIO];
+        }
+        TX_INICIO = (TX_INICIO + 1) & TX_MASK;
+    }
+}
+
+// SSPIF: cada byte terminado se entrega a SPI_SIGUIENTE como en isr(), y
+// BCLIF a I2C_COLISION
+void SIM_MSSP(void){
+    while(SIM_SSPIF || SIM_BCLIF){
+        if(SIM_SSPIF){
+            SIM_SSPIF = 0;
+            DATO_SPI = SIM_SSPBUF;
+            SPI_SIGUIENTE();
+        }
+#if TRANSPORTE_I2C
+        if(SIM_BCLIF){
+            SIM_BCLIF = 0;
+            I2C_COLISION();
+        }
+#endif
+    }
+}
+
+// Escritura en SSPBUF: intercambia un byte con el esclavo seleccionado
+void SIM_SPI_ENVIAR(uint8_t DATO){
+    struct ESCLAVO_SIM *E;
+    SIM_BYTES_MSSP++;
+    SIM_EVENTOS_MSSP++;
+    SIM_BITS_BUS += 8;
+    SIM_SSPIF = 1;
+    SIM_SSPBUF = 0xFF;                      // MISO sin esclavo queda en 1
+    if(SIM_CS >= N_ESCLAVOS || !ESCLAVOS_SIM[SIM_CS].PRESENTE){
+        return;
+    }
+    E = &ESCLAVOS_SIM[SIM_CS];
+    SIM_SSPBUF = (E->K < SPI_RESPUESTA_LEN) ? E->RESPUESTA[E->K] : 0;
+    E->K++;
+    if(E->N < SPI_TRAMA_MAX){
+        E->RX[E->N++] = DATO;
+    }
+}
+
+void SIM_SPI_CS(uint8_t ESCLAVO, uint8_t NIVEL){
+    if(!NIVEL){
+        SIM_CS = ESCLAVO;
+        ESCLAVOS_SIM[ESCLAVO].N = 0;
+        ESCLAVOS_SIM[ESCLAVO].K = 0;
+        return;
+    }
+    if(SIM_CS == ESCLAVO && ESCLAVOS_SIM[ESCLAVO].PRESENTE){
+        ESCLAVO_TRAMA(&ESCLAVOS_SIM[ESCLAVO]);
+    }
+    SIM_CS = 0xFF;
+}
+
+// I2C: inicio o reinicio (PARADA = 0) y parada. El esclavo revisa la trama en
+// la parada, como al subir su chip-select en SPI, as que lo que devolvi en
+// la lectura refleja la trama anterior igual que en SPI
+void SIM_I2C_CONDICION(uint8_t PARADA){
+    SIM_EVENTOS_MSSP++;
+    SIM_BITS_BUS++;
+    SIM_SSPIF = 1;
+    if(!PARADA){
+        SIM_I2C_DIRECCION = 1;
+        return;
+    }
+    if(SIM_I2C_DIR < N_ESCLAVOS){
+        ESCLAVO_TRAMA(&ESCLAVOS_SIM[SIM_I2C_DIR]);
+    }
+    SIM_I2C_DIR = 0xFF;
+}
+
+// Escritura en SSPBUF con el bus en I2C: direccin tras un inicio, o un byte
+// del cuerpo. El esclavo no recibe la cabecera, as que se agrega al guardar
+// la direccin de escritura para revisar la trama con ESCLAVO_TRAMA
+void SIM_I2C_ENVIAR(uint8_t DATO){
+    struct ESCLAVO_SIM *E;
+    uint8_t ESCLAVO;
+    SIM_BYTES_MSSP++;
+    SIM_EVENTOS_MSSP++;
+    SIM_BITS_BUS += 9;
+    if(SIM_I2C_COLISION >= 0 && SIM_I2C_COLISION-- == 0){
+        SIM_BCLIF = 1;                      // Otro dispositivo gan SDA: BCLIF sin SSPIF
+        return;
+    }
+    SIM_SSPIF = 1;
+    SIM_I2C_NACK = 1;                       // Nadie tira SDA a 0 en el ACK
+    if(SIM_I2C_DIRECCION){
+        SIM_I2C_DIRECCION = 0;
+        ESCLAVO = (DATO >> 1) - I2C_BASE;
+        if(ESCLAVO >= N_ESCLAVOS || !ESCLAVOS_SIM[ESCLAVO].PRESENTE){
+            SIM_I2C_DIR = 0xFF;
+            return;
+        }
+        E = &ESCLAVOS_SIM[ESCLAVO];
+        if(!(DATO & 1)){
+            E->RX[0] = SPI_CABECERA;
+            E->N = 1;
+            E->K = 0;
+        }
+        SIM_I2C_DIR = ESCLAVO;
+        SIM_I2C_NACK = 0;
+        return;
+    }
+    if(SIM_I2C_DIR >= N_ESCLAVOS){
+        return;
+    }
+    E = &ESCLAVOS_SIM[SIM_I2C_DIR];
+    if(E->N < SPI_TRAMA_MAX){
+        E->RX[E->N++] = DATO;
+    }
+    SIM_I2C_NACK = 0;
+}
+
+// RCEN: el esclavo direccionado para lectura entrega su siguiente byte
+void SIM_I2C_RECIBIR(void){
+    struct ESCLAVO_SIM *E;
+    SIM_BYTES_MSSP++;
+    SIM_EVENTOS_MSSP++;
+    SIM_BITS_BUS += 8;
+    SIM_SSPIF = 1;
+    SIM_SSPBUF = 0xFF;
+    if(SIM_I2C_DIR >= N_ESCLAVOS){
+        return;
+    }
+    E = &ESCLAVOS_SIM[SIM_I2C_DIR];
+    SIM_SSPBUF = (E->K < SPI_RESPUESTA_LEN) ? E->RESPUESTA[E->K] : 0xFF;
+    E->K++;
+}
+
+// Recuperacin tras BCLIF (I2C_LIBERAR del firmware): el esclavo direccionado
+// ve la parada generada a mano y revisa lo que alcanz a recibir, y SSPIF
+// queda en 1 para que SPI_SIGUIENTE cierre la trama
+void I2C_LIBERAR(void){
+    SIM_I2C_LIBERACIONES++;
+    SIM_BITS_BUS += 10;                     // Hasta 9 pulsos en SCL y la parada
+    if(SIM_I2C_DIR < N_ESCLAVOS){
+        ESCLAVO_TRAMA(&ESCLAVOS_SIM[SIM_I2C_DIR]);
+    }
+    SIM_I2C_DIR = 0xFF;
+    SIM_I2C_DIRECCION = 0;
+    SIM_SSPIF = 1;
+}
+
+// ACKEN: el maestro reconoce (o no, en el ltimo) el byte recibido
+void SIM_I2C_ACK(uint8_t NACK){
+    (void)NACK;
+    SIM_EVENTOS_MSSP++;
+    SIM_BITS_BUS++;
+    SIM_SSPIF = 1;
+}
+
+// Fin de la ventana de chip-select: revisa la trama recibida como lo hara el
+// firmware del esclavo y prepara la respuesta para la siguiente
+void ESCLAVO_TRAMA(struct ESCLAVO_SIM *E){
+    uint8_t J, N = 2, SUMA;
+    E->TRAMAS++;
+    if(E->N < 3 || E->RX[0] != SPI_CABECERA){
+        E->ESTADO = 1;
+        ESCLAVO_RESPUESTA(E);
+        return;
+    }
+    SUMA = E->RX[1];
+    for(J = 0; J < CANALES_ESCLAVO; J++){
+        if((E->RX[1] & (1 << J)) && N < E->N){
+            SUMA += E->RX[N++];
+        }
+    }
+    if(N >= E->N || (uint8_t)(SUMA + E->RX[N]) != 0){
+        E->ESTADO = 1;
+        ESCLAVO_RESPUESTA(E);
+        return;
+    }
+    E->ESTADO = 0;
+    E->CONTADOR++;
+    N = 2;
+    for(J = 0; J < CANALES_ESCLAVO; J++){
+        if(E->RX[1] & (1 << J)){
+            E->ESPERA[J] = E->RX[N++];
+        }
+    }
+    if(!(E->RX[1] & MASCARA_LATCH)){        // Sin latch se aplica de inmediato
+        memcpy(E->POS, E->ESPERA, CANALES_ESCLAVO);
+    }
+    ESCLAVO_RESPUESTA(E);
+}
+
+// {CONTADOR, ESTADO, posiciones, SUMA} con todos los bytes sumando SPI_RESP_SUMA
+void ESCLAVO_RESPUESTA(struct ESCLAVO_SIM *E){
+    uint8_t J, SUMA;
+    E->RESPUESTA[0] = E->CONTADOR;
+    E->RESPUESTA[1] = E->ESTADO;
+    SUMA = E->CONTADOR + E->ESTADO;
+    for(J = 0; J < CANALES_ESCLAVO; J++){
+        E->RESPUESTA[2 + J] = E->POS[J];
+        SUMA += E->POS[J];
+    }
+    E->RESPUESTA[SPI_RESPUESTA_LEN - 1] = SPI_RESP_SUMA - SUMA;
+}
+
+// EEPROM de datos: la escritura es inmediata. Con SIM_EE_CORTE >= 0 solo se
+// completan esas escrituras y las siguientes se pierden, como un corte de
+// energa a mitad de una actualizacin
+uint8_t LECTURA_EEPROM(uint8_t DIRECCION){
+    return SIM_EEPROM[DIRECCION];
+}
+
+void ESCRITURA_EEPROM(uint8_t DIRECCION, uint8_t DATA){
+    if(SIM_EE_CORTE == 0){
+        return;
+    }
+    if(SIM_EE_CORTE > 0){
+        SIM_EE_CORTE--;
+    }
+    if(SIM_EEPROM[DIRECCION] != DATA){      // Como EEPROM_SIGUIENTE, omite bytes iguales
+        SIM_EEPROM[DIRECCION] = DATA;
+        SIM_EE_ESCRITURAS++;
+    }
+}
+
+// Memoria de programa: solo la regin de trayectorias. Como en el PIC, la
+// escritura es de un bloque alineado de FLASH_BLOQUE palabras de 14 bits
+void FLASH_ESCRIBIR_BLOQUE(uint16_t DIRECCION, const uint16_t *PALABRAS){
+    uint8_t J;
+    if(DIRECCION < FLASH_INICIO || DIRECCION + FLASH_BLOQUE > FLASH_FIN || (DIRECCION & (FLASH_BLOQUE - 1))){
+        return;                             // Fuera de la regin o sin alinear: no se cuenta
+    }
+    for(J = 0; J < FLASH_BLOQUE; J++){
+        SIM_FLASH[DIRECCION - FLASH_INICIO + J] = PALABRAS[J] & 0x3FFF;
+    }
+    SIM_FLASH_BLOQUES++;
+}
+
+uint16_t FLASH_LEER(uint16_t DIRECCION){
+    if(DIRECCION < FLASH_INICIO || DIRECCION >= FLASH_FIN){
+        return 0x3FFF;
+    }
+    return SIM_FLASH[DIRECCION - FLASH_INICIO];
+}
@@ -0,0 +1,644 @@
+/*
+ * File:   pruebas.c
+ * Escenarios del maestro corridos sobre los perifricos simulados (make
+ * simulacion). Cada comprobacin imprime "ok" o "FALLA"; el programa termina
+ * con 1 si alguna fall
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "../nucleo.h"
+#include "hw_sim.h"
+
+/*------------------------------------------------------------------------------
+ * VARIABLES
+ ------------------------------------------------------------------------------*/
+uint8_t FALLAS;
+uint8_t RESP[TRAMA_MAX];                    // Datos de la ltima respuesta encontrada
+uint8_t RESP_LEN;
+
+/*------------------------------------------------------------------------------
+ * FUNCIONES
+ ------------------------------------------------------------------------------*/
+void REVISAR(uint8_t CONDICION, const char *NOMBRE){
+    printf("%s %s\n", CONDICION ? "ok   " : "FALLA", NOMBRE);
+    if(!CONDICION){
+        FALLAS++;
+    }
+}
+
+// Cada periodo de TMR0 seguido de una vuelta del lazo de main()
+void CORRER(uint16_t PERIODOS){
+    while(PERIODOS--){
+        SIM_CORRER(1);
+        NUCLEO_PRINCIPAL();
+    }
+}
+
+void POTENCIOMETROS(uint8_t AN0, uint8_t AN1, uint8_t AN2, uint8_t AN3){
+    SIM_ADC[0] = AN0;
+    SIM_ADC[1] = AN1;
+    SIM_ADC[2] = AN2;
+    SIM_ADC[3] = AN3;
+}
+
+// RB0 hasta llegar al modo M
+void IR_MODO(uint8_t M){
+    while(MODO != M){
+        NUCLEO_BOTONES(0b110);
+        CORRER(1);
+    }
+}
+
+// Posicin que devuelve la flash para P: 7 bits por articulacin
+uint8_t EN_FLASH(uint8_t P){
+    return EXPANDIR_7(COMPRIMIR_7(P));
+}
+
+// Enva una trama del protocolo propio y deja la salida de TX desde cero
+void ENVIAR(uint8_t CMD, const uint8_t *DATOS, uint8_t LEN){
+    uint8_t TRAMA[TRAMA_MAX + 4];
+    uint8_t J, CRC;
+    TRAMA[0] = TRAMA_SYNC;
+    TRAMA[1] = CMD;
+    TRAMA[2] = LEN;
+    CRC = CRC8(CRC8(0, CMD), LEN);
+    for(J = 0; J < LEN; J++){
+        TRAMA[3 + J] = DATOS[J];
+        CRC = CRC8(CRC, DATOS[J]);
+    }
+    TRAMA[3 + LEN] = CRC;
+    SIM_TX_N = 0;
+    SIM_RECIBIR(TRAMA, LEN + 4);
+    NUCLEO_PRINCIPAL();
+    CORRER(1);                              // TXIF enva la respuesta
+}
+
+// Busca en lo transmitido una trama CMD con CRC correcto y copia sus datos
+uint8_t RESPUESTA(uint8_t CMD){
+    uint16_t I;
+    uint8_t J, LEN, CRC;
+    for(I = 0; I + 3 < SIM_TX_N; I++){
+        if(SIM_TX[I] != TRAMA_SYNC || SIM_TX[I + 1] != CMD){
+            continue;
+        }
+        LEN = SIM_TX[I + 2];
+        if(LEN > TRAMA_MAX || I + 3 + LEN >= SIM_TX_N){
+            continue;
+        }
+        CRC = CRC8(CRC8(0, CMD), LEN);
+        for(J = 0; J < LEN; J++){
+            CRC = CRC8(CRC, SIM_TX[I + 3 + J]);
+        }
+        if(CRC == SIM_TX[I + 3 + LEN]){
+            memcpy(RESP, &SIM_TX[I + 3], LEN);
+            RESP_LEN = LEN;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+uint8_t CONTAR_TRAMAS(uint8_t CMD){
+    uint16_t I;
+    uint8_t N = 0;
+    for(I = 0; I + 1 < SIM_TX_N; I++){
+        if(SIM_TX[I] == TRAMA_SYNC && SIM_TX[I + 1] == CMD){
+            N++;
+        }
+    }
+    return N;
+}
+
+uint16_t DUTY_TABLA(uint8_t POS){
+    return ((uint16_t)TABLA_POT[POS].CCPRL << 2) | (TABLA_POT[POS].DCB >> 4);
+}
+
+// El map() en flotante que reemplaz el punto fijo de TABLA_POT
+uint16_t MAP_FLOTANTE(uint8_t X){
+    return (uint16_t)(OUT_MIN1 + ((float)(OUT_MAX1 - OUT_MIN1)/(IN_MAX - IN_MIN))*(X - IN_MIN));
+}
+
+void PRUEBA_TABLA(void){
+    uint16_t I;
+    uint8_t CRECE = 1, IGUAL = 1;
+    for(I = 1; I < 256; I++){
+        if(DUTY_TABLA(I) < DUTY_TABLA(I - 1)){
+            CRECE = 0;
+        }
+    }
+    for(I = 0; I < 256; I++){
+        if(DUTY_TABLA(I) != MAP_FLOTANTE(I)){
+            printf("      TABLA_POT[%u] = %u, map() = %u\n", I, DUTY_TABLA(I), MAP_FLOTANTE(I));
+            IGUAL = 0;
+        }
+    }
+    REVISAR(DUTY_TABLA(0) == OUT_MIN1 && DUTY_TABLA(255) == OUT_MAX1, "TABLA_POT cubre OUT_MIN1 - OUT_MAX1");
+    REVISAR(CRECE, "TABLA_POT es montona");
+    REVISAR(IGUAL, "TABLA_POT igual al map() en flotante en las 256 entradas");
+}
+
+void PRUEBA_MANUAL(void){
+    SIM_ADC[0] = 0;
+    SIM_ADC[1] = 255;
+    SIM_ADC[2] = 100;
+    SIM_ADC[3] = 200;
+    CORRER(50);
+    REVISAR(POT_1 == 0 && POT_2 == 255 && POT_3 == 100 && POT_4 == 200, "MODO 0 sigue a los potencimetros");
+    REVISAR(SIM_DUTY(1) == OUT_MIN1 && SIM_DUTY(2) == OUT_MAX1, "CCP1/CCP2 propios con AN0/AN1");
+    REVISAR(ESCLAVOS_SIM[0].POS[0] == 100 && ESCLAVOS_SIM[0].POS[1] == 200, "El ESCLAVO1 aplica AN2/AN3");
+    REVISAR(SALUD[0].FALLOS == 0 && SALUD[0].ERRORES == 0 && SALUD[0].TRAMAS > 0, "Respuestas del esclavo vlidas");
+}
+
+void PRUEBA_PROTOCOLO(void){
+    uint8_t DATOS[2] = {0, 50};
+    ENVIAR(CMD_CONSULTA, DATOS, 0);
+    REVISAR(RESPUESTA(CMD_CONSULTA | CMD_RESPUESTA) && RESP_LEN == 4 && RESP[1] == 255 && RESP[3] == 200,
+            "CMD_CONSULTA devuelve las posiciones");
+    ENVIAR(CMD_POSICION, DATOS, 2);
+    REVISAR(RESPUESTA(CMD_POSICION | CMD_RESPUESTA) && RESP[0] == ESTADO_MODO, "CMD_POSICION rechazado fuera de MODO 2");
+    ENVIAR(0x7E, DATOS, 0);
+    REVISAR(RESPUESTA(0x7E | CMD_RESPUESTA) && RESP[0] == ESTADO_INVALIDO, "Comando desconocido");
+    DATOS[0] = 0;
+    ENVIAR(CMD_ESCLAVO, DATOS, 1);
+    REVISAR(RESPUESTA(CMD_ESCLAVO | CMD_RESPUESTA) && RESP[0] == 0 && RESP[6] == 100 && RESP[7] == 200,
+            "CMD_ESCLAVO informa la posicin del esclavo");
+}
+
+void PRUEBA_MODO2(void){
+    uint8_t DATOS[6] = {0, 50};
+    uint8_t POLOLU[4];
+    uint8_t I;
+    NUCLEO_BOTONES(0b110);                  // MODO 1
+    CORRER(10);
+    NUCLEO_BOTONES(0b110);                  // MODO 2
+    CORRER(10);
+    REVISAR(MODO == 2 && POT_1 == 0 && POT_2 == 255, "MODO 2 arranca desde la posicin actual");
+
+    ENVIAR(CMD_POSICION, DATOS, 2);
+    CORRER(10);
+    REVISAR(RESPUESTA(CMD_POSICION | CMD_RESPUESTA) && RESP[0] == ESTADO_OK && POT_1 == 50 &&
+            SIM_DUTY(1) == DUTY_TABLA(50), "CMD_POSICION mueve CCP1");
+
+    POLOLU[0] = POLOLU_OBJETIVO;            // Canal 1 a 1500 us
+    POLOLU[1] = 1;
+    POLOLU[2] = 6000 & 0x7F;
+    POLOLU[3] = 6000 >> 7;
+    SIM_RECIBIR(POLOLU, 4);
+    CORRER(20);                             // Una ronda completa aun con 2 esclavos
+    REVISAR(POT_2 >= 137 && POT_2 <= 138 && SIM_DUTY(2) >= 374 && SIM_DUTY(2) <= 376, "Pololu Set Target a 1500 us");
+
+    POLOLU[0] = MINI_SSC;                   // Canal 2 (ESCLAVO1) a la mitad
+    POLOLU[1] = 2;
+    POLOLU[2] = 127;
+    SIM_RECIBIR(POLOLU, 3);
+    CORRER(20);
+    REVISAR(POT_3 == 128 && ESCLAVOS_SIM[0].POS[0] == 128, "Mini-SSC llega al esclavo");
+#if N_ESCLAVOS > 1
+    POLOLU[1] = 4;                          // Canal extra: pasa por la cola de la interrupcin
+    SIM_RECIBIR(POLOLU, 3);
+    CORRER(20);
+    REVISAR(EXTRA_INICIO == EXTRA_FIN && ESCLAVOS_SIM[1].POS[0] == 128, "Mini-SSC llega al canal extra");
+#endif
+
+    POLOLU[0] = POLOLU_VELOCIDAD;           // 10 cuartos de us cada 10 ms
+    POLOLU[1] = 0;
+    POLOLU[2] = 10;
+    POLOLU[3] = 0;
+    SIM_RECIBIR(POLOLU, 4);
+    DATOS[0] = 0;
+    DATOS[1] = 250;
+    ENVIAR(CMD_POSICION, DATOS, 2);
+    CORRER(100);
+    REVISAR(POT_1 > 50 && POT_1 < 250, "Set Speed limita el avance");
+    POLOLU[2] = 0;
+    SIM_RECIBIR(POLOLU, 4);
+    CORRER(10);
+    REVISAR(POT_1 == 250, "Velocidad 0 llega de inmediato");
+
+    POLOLU[0] = POLOLU_ACELERACION;         // Rampa de 20 unidades Pololu, sin lmite de velocidad
+    POLOLU[2] = 20;
+    SIM_RECIBIR(POLOLU, 4);
+    DATOS[1] = 0;
+    ENVIAR(CMD_POSICION, DATOS, 2);
+    CORRER(100);
+    I = 250 - POT_1;                        // Avance en los primeros 200 ms
+    CORRER(100);
+    REVISAR(I > 0 && POT_1 > 0 && 250 - POT_1 - I > 2 * I, "Set Acceleration arranca despacio y acelera");
+    CORRER(300);
+    REVISAR(POT_1 == 0 && VEL_ACTUAL[0] == 0, "Con aceleracin llega al objetivo");
+    POLOLU[2] = 0;
+    SIM_RECIBIR(POLOLU, 4);
+    CORRER(10);
+
+    DATOS[0] = 0xE8;                        // T = 1000
+    DATOS[1] = 0x03;
+    DATOS[2] = 10;
+    DATOS[3] = 20;
+    DATOS[4] = 30;
+    DATOS[5] = 40;
+    ENVIAR(CMD_TRAYECTORIA, DATOS, 6);
+    REVISAR(RESPUESTA(CMD_TRAYECTORIA | CMD_RESPUESTA) && RESP[0] == ESTADO_OK && RESP[1] == TRAY_MASK - 1,
+            "Punto de trayectoria encolado");
+    DATOS[0] = 0x1A;                        // T = 1050
+    DATOS[1] = 0x04;
+    DATOS[2] = 60;
+    ENVIAR(CMD_TRAYECTORIA, DATOS, 6);
+    CORRER(10);
+    REVISAR(POT_1 == 10 && POT_4 == 40, "El primer punto se aplica de inmediato");
+    CORRER(30);
+    REVISAR(POT_1 == 10, "El segundo punto espera su T");
+    CORRER(15);
+    REVISAR(POT_1 == 60, "El segundo punto se aplica a los 100 ms");
+
+    DATOS[0] = 0x00;                        // Un punto pendiente (T = 2048) y una vuelta por los modos
+    DATOS[1] = 0x08;
+    DATOS[2] = 90;
+    ENVIAR(CMD_TRAYECTORIA, DATOS, 6);
+    for(I = 0; I < N_MODOS; I++){
+        NUCLEO_BOTONES(0b110);
+    }
+    CORRER(10);
+    REVISAR(MODO == 2 && POT_1 == 60 && TRAY_LIBRES() == TRAY_MASK, "Cambiar de modo descarta la trayectoria");
+}
+
+// Host a 9600 baudios que llena la cola segn los crditos con puntos cada
+// 40 ms y se detiene PAUSA periodos de TMR0 a mitad de la trayectoria. Cada
+// punto es una ida y vuelta de 16 bytes (~17 ms, 9 periodos). Devuelve los
+// puntos que llegaron despus de su T
+uint8_t PUNTOS_TARDE(uint16_t PAUSA){
+    uint8_t DATOS[6];
+    uint8_t TRAMA[10];
+    uint16_t T, P, LISTO = 0;
+    uint8_t K = 0, J, TARDE = 0;
+    for(P = 0; K < 30; P++){
+        if(P >= LISTO && (P < 200 || P >= 200 + PAUSA) && TRAY_LIBRES() > 0){
+            T = 3000 + K * 20;
+            if(TRAY_ACTIVA && (int16_t)(TRAY_RELOJ - T) >= 0){
+                TARDE++;
+            }
+            DATOS[0] = (uint8_t)T;
+            DATOS[1] = (uint8_t)(T >> 8);
+            for(J = 2; J < 6; J++){
+                DATOS[J] = K;
+            }
+            TRAMA[0] = TRAMA_SYNC;
+            TRAMA[1] = CMD_TRAYECTORIA;
+            TRAMA[2] = 6;
+            TRAMA[9] = CRC8(CRC8(0, CMD_TRAYECTORIA), 6);
+            for(J = 0; J < 6; J++){
+                TRAMA[3 + J] = DATOS[J];
+                TRAMA[9] = CRC8(TRAMA[9], DATOS[J]);
+            }
+            SIM_RECIBIR(TRAMA, 10);
+            LISTO = P + 9;
+            K++;
+        }
+        CORRER(1);
+    }
+    CORRER(TRAY_TAM * 20 + TRAY_ESPERA + 10);   // Se aplica lo pendiente y el reloj se detiene
+    return TARDE;
+}
+
+// Tamao de la cola medido: la pausa ms larga del host que no deja llegar
+// tarde ningn punto
+void PRUEBA_COLA_TRAYECTORIA(void){
+    uint16_t PAUSA = 0;
+    IR_MODO(2);
+    while(PAUSA < 500 && PUNTOS_TARDE(PAUSA + 5) == 0){
+        PAUSA += 5;
+    }
+    SIM_TX_N = 0;
+    printf("Cola de %u puntos: el host puede detenerse %u ms con puntos cada 40 ms\n", TRAY_TAM, PAUSA * 2);
+    REVISAR(PAUSA * 2 >= 60, "La cola aguanta pausas del host de decenas de ms");
+}
+
+void PRUEBA_TELEMETRIA(void){
+    uint8_t DATOS[1] = {10};                // 20 ms -> 50 Hz
+    ENVIAR(CMD_TELEMETRIA, DATOS, 1);
+    SIM_TX_N = 0;
+    CORRER(105);                            // La dcima sale en el periodo siguiente
+    REVISAR(CONTAR_TRAMAS(TRAMA_TELEMETRIA) == 10, "Telemetra cada 10 periodos de TMR0");
+    REVISAR(RESPUESTA(TRAMA_TELEMETRIA) && RESP_LEN == TELEMETRIA_LEN && RESP[1] == 2, "Trama de telemetra vlida");
+    DATOS[0] = 0;
+    ENVIAR(CMD_TELEMETRIA, DATOS, 1);
+}
+
+// Un segundo de tramas a los esclavos: bytes, eventos del MSSP y tiempo del
+// bus por trama con el transporte compilado (TRANSPORTE_I2C)
+void PRUEBA_TRANSPORTE(void){
+    uint16_t TRAMAS = ESCLAVOS_SIM[0].TRAMAS;
+    uint32_t BYTES = SIM_BYTES_MSSP;
+    uint32_t EVENTOS = SIM_EVENTOS_MSSP;
+    uint32_t BITS = SIM_BITS_BUS;
+    uint32_t US;
+    CORRER(500);
+    TRAMAS = ESCLAVOS_SIM[0].TRAMAS - TRAMAS;
+    BYTES = SIM_BYTES_MSSP - BYTES;
+    EVENTOS = SIM_EVENTOS_MSSP - EVENTOS;
+    US = (SIM_BITS_BUS - BITS)*SIM_US_BIT/(TRAMAS ? TRAMAS : 1);
+    printf("%s: %u tramas/s, %lu bytes/s, %.1f bytes y %.1f eventos del MSSP por trama, "
+           "%lu us de bus por trama (sin contar isr(), el bus da para %lu tramas/s)\n",
+           TRANSPORTE_I2C ? "I2C" : "SPI", TRAMAS, (unsigned long)BYTES,
+           (double)BYTES/TRAMAS, (double)EVENTOS/TRAMAS, (unsigned long)US, 1000000UL/US);
+    REVISAR(TRAMAS >= 500/(SPI_PERIODO*N_ESCLAVOS) - 1 && SALUD[0].FALLOS == 0,
+            "Una trama por esclavo cada SPI_PERIODO*N_ESCLAVOS periodos");
+    REVISAR(US < SPI_PERIODO*2000UL, "La trama cabe en SPI_PERIODO");
+}
+
+void PRUEBA_ESCLAVO_AUSENTE(void){
+    ESCLAVOS_SIM[0].PRESENTE = 0;
+    CORRER(40);
+    REVISAR(SALUD[0].FALLOS >= 5, "Esclavo ausente cuenta FALLOS");
+    ESCLAVOS_SIM[0].PRESENTE = 1;
+    CORRER(40);
+    REVISAR(SALUD[0].FALLOS == 0, "El esclavo vuelve a responder");
+}
+
+#if TRANSPORTE_I2C
+// Colisin (BCLIF) a mitad de una trama: I2C_COLISION libera el bus, la trama
+// abandonada cuenta como un fallo y las siguientes salen normalmente
+void PRUEBA_COLISION(void){
+    uint8_t E, C, I, TRAMAS, BIEN = 1;
+    uint8_t PREVIO = MODO;
+    IR_MODO(0);
+    POTENCIOMETROS(10, 20, 30, 40);
+    CORRER(20);
+    SIM_I2C_COLISION = 2;                   // El tercer byte escrito en SSPBUF
+    for(I = 0; I < 20 && SIM_I2C_LIBERACIONES == 0; I++){
+        CORRER(1);
+    }
+    C = SPI_ESCLAVO;                        // Esclavo de la trama abandonada
+    REVISAR(SIM_I2C_LIBERACIONES == 1 && !SPI_OCUPADO && SALUD[C].FALLOS == 1,
+            "La colisin cierra la trama como fallo y libera el bus");
+    TRAMAS = SALUD[C].TRAMAS;
+    POTENCIOMETROS(90, 100, 110, 120);
+    CORRER(40);
+    for(E = 0; E < N_ESCLAVOS; E++){
+        if(SALUD[E].FALLOS != 0){
+            BIEN = 0;
+        }
+    }
+    REVISAR(BIEN && SIM_I2C_LIBERACIONES == 1 && SALUD[C].TRAMAS != TRAMAS && ESCLAVOS_SIM[0].POS[0] == 110 &&
+            ESCLAVOS_SIM[0].POS[1] == 120, "Las tramas siguen tras la colisin");
+    IR_MODO(PREVIO);                        // PRUEBA_REGISTRO cuenta los cambios de modo desde aqu
+}
+#endif
+
+// Recupera el registro desde la EEPROM simulada como al arrancar
+void REARRANCAR(void){
+    memset(LOG_VALOR, 0, sizeof(LOG_VALOR));
+    LOG_RECUPERAR();
+}
+
+void PRUEBA_REGISTRO(void){
+    uint8_t I;
+    uint8_t ULTIMA[4];
+    NUCLEO_BOTONES(0b110);                  // MODO 3
+    NUCLEO_BOTONES(0b110);                  // MODO 4
+    NUCLEO_BOTONES(0b110);                  // MODO 0
+    CORRER(10);
+    REARRANCAR();
+    REVISAR(LOG_RANURA[CLAVE_MODO] != LOG_VACIO && LOG_VALOR[CLAVE_MODO][0] == 0, "El modo queda en el registro");
+    memcpy(ULTIMA, LOG_VALOR[CLAVE_ULTIMA], 4);
+    for(I = 0; I < 3 * LOG_RANURAS; I++){   // Varias vueltas del registro con una sola clave
+        SIM_ADC[0] = I;
+        CORRER(10);
+        NUCLEO_BOTONES(0b101);              // RB1 guarda la pose 0
+        CORRER(1);
+    }
+    REARRANCAR();
+    REVISAR(LOG_VALOR[CLAVE_POSE(0)][0] == 3 * LOG_RANURAS - 1, "La pose ms nueva se recupera");
+    REVISAR(LOG_RANURA[CLAVE_MODO] != LOG_VACIO && LOG_VALOR[CLAVE_MODO][0] == 0 &&
+            memcmp(ULTIMA, LOG_VALOR[CLAVE_ULTIMA], 4) == 0, "Las otras claves sobreviven a la compactacin");
+}
+
+// MODO 1: la pose guardada con RB1 en MODO 0 vuelve una articulacin por segundo
+void PRUEBA_POSES(void){
+    IR_MODO(0);
+    POTENCIOMETROS(10, 20, 30, 40);
+    CORRER(20);
+    NUCLEO_BOTONES(0b101);                  // RB1 guarda la pose 0
+    CORRER(1);
+    POTENCIOMETROS(200, 210, 220, 230);
+    CORRER(20);
+    IR_MODO(1);
+    REVISAR(SIM_LEDS == LEDS_MODO[1], "LEDs del MODO 1");
+    NUCLEO_BOTONES(0b101);                  // RB1 carga la pose 0
+    CORRER(TICKS_PASO * SIM_PERIODOS_TICK / 2);
+    REVISAR(BANDERA_R == 1 && POT_1 == 10 && SIM_DUTY(1) == DUTY_TABLA(200), "La pose cargada espera su turno");
+    CORRER(TICKS_PASO * SIM_PERIODOS_TICK);
+    REVISAR(SIM_DUTY(1) == DUTY_TABLA(10) && SIM_DUTY(2) == DUTY_TABLA(210), "La primera articulacin se mueve tras 1 s");
+    CORRER(PASOS_REPRODUCCION * TICKS_PASO * SIM_PERIODOS_TICK);
+    REVISAR(BANDERA_R == 0 && SIM_DUTY(2) == DUTY_TABLA(20) && ESCLAVOS_SIM[0].POS[0] == 30 &&
+            ESCLAVOS_SIM[0].POS[1] == 40, "La pose completa se reproduce");
+}
+
+// MODO 3: dos registros grabados con RB1 se reproducen en ciclo con RB2
+void PRUEBA_SECUENCIA(void){
+    IR_MODO(3);
+    POTENCIOMETROS(50, 60, 70, 80);
+    CORRER(20);
+    NUCLEO_BOTONES(0b101);                  // RB1 graba el primer registro
+    CORRER(20 * SIM_PERIODOS_TICK);         // Su permanencia: ~1 s
+    POTENCIOMETROS(150, 160, 170, 180);
+    CORRER(20);
+    NUCLEO_BOTONES(0b101);                  // Segundo registro
+    CORRER(1);
+    REVISAR(SEC_CUENTA == 2 && LECTURA_EEPROM(SEC_BASE) == SEC_MAGICO, "MODO 3 graba dos registros");
+    POTENCIOMETROS(0, 0, 0, 0);
+    CORRER(20);
+    NUCLEO_BOTONES(0b011);                  // RB2 reproduce
+    CORRER(10);
+    REVISAR(SEC_REPRODUCIENDO == 1 && SEC_INDICE == 0 && SIM_DUTY(1) == DUTY_TABLA(50), "La secuencia arranca en el primer registro");
+    CORRER(30 * SIM_PERIODOS_TICK);
+    REVISAR(SEC_INDICE == 1 && SIM_DUTY(1) == DUTY_TABLA(150) && ESCLAVOS_SIM[0].POS[1] == 180,
+            "Pasa al segundo registro tras la permanencia grabada");
+    CORRER(30 * SIM_PERIODOS_TICK);
+    REVISAR(SEC_INDICE == 0 && POT_1 == 50, "Al final vuelve al primer registro");
+    NUCLEO_BOTONES(0b011);                  // RB2 detiene
+    CORRER(20);
+    REVISAR(SEC_REPRODUCIENDO == 0 && POT_1 == 0, "Los potencimetros retoman el control");
+    SEC_CUENTA = 0;                         // Arranque: modo y secuencia desde la EEPROM
+    memset(LOG_VALOR, 0, sizeof(LOG_VALOR));
+    NUCLEO_INICIAR();
+    REVISAR(MODO == 3 && SEC_CUENTA == 2, "El modo y la secuencia sobreviven al reinicio");
+}
+
+// MODO 4: grabacin continua en la flash, reproduccin y su cuenta en el registro
+void PRUEBA_FLASH(void){
+    uint16_t BLOQUES;
+    IR_MODO(4);
+    REVISAR(SIM_LEDS == LEDS_MODO[4], "LEDs del MODO 4");
+    POTENCIOMETROS(100, 20, 200, 40);
+    CORRER(20);
+    BLOQUES = SIM_FLASH_BLOQUES;
+    NUCLEO_BOTONES(0b101);                  // RB1 inicia la grabacin
+    CORRER(10 * FLASH_TICKS * SIM_PERIODOS_TICK);
+    POTENCIOMETROS(30, 250, 60, 90);
+    CORRER(10 * FLASH_TICKS * SIM_PERIODOS_TICK + SIM_PERIODOS_TICK);
+    REVISAR(FLASH_ESTADO == FLASH_GRABANDO && FLASH_INDICE >= 19 && FLASH_INDICE <= 21, "Una muestra cada FLASH_TICKS");
+    NUCLEO_BOTONES(0b101);                  // RB1 termina
+    CORRER(1);
+    REVISAR(FLASH_ESTADO == FLASH_LIBRE && FLASH_CUENTA == FLASH_INDICE &&
+            SIM_FLASH_BLOQUES - BLOQUES == (FLASH_CUENTA * FLASH_PALABRAS_MUESTRA + FLASH_BLOQUE - 1) / FLASH_BLOQUE,
+            "Al detener se escribe el bloque incompleto");
+    REVISAR(SIM_FLASH[0] == (((uint16_t)COMPRIMIR_7(100) << 7) | COMPRIMIR_7(20)) &&
+            SIM_FLASH[FLASH_CUENTA * FLASH_PALABRAS_MUESTRA - 1] == (((uint16_t)COMPRIMIR_7(60) << 7) | COMPRIMIR_7(90)),
+            "Las muestras quedan en la memoria de programa");
+    REVISAR(BANDERA_CUENTA == 0 && LOG_VALOR[CLAVE_FLASH][0] == FLASH_MAGICO &&
+            (LOG_VALOR[CLAVE_FLASH][1] | ((uint16_t)LOG_VALOR[CLAVE_FLASH][2] << 8)) == FLASH_CUENTA,
+            "BANDERA_CUENTA guarda el nmero de muestras");
+
+    POTENCIOMETROS(0, 0, 0, 0);
+    CORRER(20);
+    NUCLEO_BOTONES(0b011);                  // RB2 reproduce
+    CORRER(FLASH_TICKS * SIM_PERIODOS_TICK + 10);
+    REVISAR(FLASH_ESTADO == FLASH_REPRODUCIENDO && POT_1 == EN_FLASH(100) && POT_3 == EN_FLASH(200) &&
+            SIM_DUTY(1) == DUTY_TABLA(EN_FLASH(100)), "La reproduccin empieza por la primera muestra");
+    CORRER(FLASH_CUENTA * FLASH_TICKS * SIM_PERIODOS_TICK - 2 * FLASH_TICKS * SIM_PERIODOS_TICK);
+    REVISAR(POT_2 == EN_FLASH(250) && ESCLAVOS_SIM[0].POS[1] == EN_FLASH(90), "Y termina en la ltima");
+    CORRER(2 * FLASH_TICKS * SIM_PERIODOS_TICK);
+    REVISAR(POT_1 == EN_FLASH(100), "Al final vuelve al inicio");
+    NUCLEO_BOTONES(0b011);                  // RB2 detiene
+    CORRER(20);
+    REVISAR(FLASH_ESTADO == FLASH_LIBRE && POT_1 == 0, "Los potencimetros retoman el control");
+
+    BLOQUES = FLASH_CUENTA;                 // Arranque: la cuenta sale del registro
+    FLASH_CUENTA = 0;
+    memset(LOG_VALOR, 0, sizeof(LOG_VALOR));
+    NUCLEO_INICIAR();
+    REVISAR(MODO == 4 && FLASH_CUENTA == BLOQUES, "El nmero de muestras sobrevive al reinicio");
+
+    NUCLEO_BOTONES(0b101);                  // Una grabacin que llena la regin
+    CORRER(1);
+    FLASH_INDICE = FLASH_MAX - 2;
+    CORRER(4 * FLASH_TICKS * SIM_PERIODOS_TICK);
+    REVISAR(FLASH_ESTADO == FLASH_LIBRE && FLASH_CUENTA == FLASH_MAX && LOG_VALOR[CLAVE_FLASH][1] == (uint8_t)FLASH_MAX &&
+            SIM_FLASH[FLASH_FIN - FLASH_INICIO - 1] == (((uint16_t)COMPRIMIR_7(0) << 7) | COMPRIMIR_7(0)),
+            "La grabacin termina al llenarse la regin");
+}
+
+// Ranura que tomara el prximo registro si solo se saltaran las ranuras
+// vigentes de las otras claves
+uint8_t SIGUIENTE_OTRAS(uint8_t CLAVE){
+    uint8_t R = LOG_CABEZA, K, OTRA;
+    do{
+        OTRA = 0;
+        for(K = 0; K < LOG_CLAVES; K++){
+            if(K != CLAVE && LOG_RANURA[K] == R){
+                OTRA = 1;
+            }
+        }
+        if(OTRA){
+            R = (R + 1 >= LOG_RANURAS) ? 0 : R + 1;
+        }
+    }while(OTRA);
+    return R;
+}
+
+// La cabeza llega a la ranura vigente de la misma clave que se escribe; un
+// corte en cualquier punto del registro nuevo no debe perder el valor anterior
+void PRUEBA_CORTE_PROPIA(void){
+    uint8_t A[4] = {11, 22, 33, 44};
+    uint8_t B[4] = {55, 66, 77, 88};
+    uint8_t X[4] = {0, 0, 0, 0};
+    uint8_t COPIA[256];
+    uint8_t I, CONSERVA = 1;
+    LOG_ESCRIBIR(CLAVE_POSE(1), A);
+    for(I = 0; I < 4 * LOG_RANURAS && SIGUIENTE_OTRAS(CLAVE_POSE(1)) != LOG_RANURA[CLAVE_POSE(1)]; I++){
+        X[0] = I;
+        LOG_ESCRIBIR(CLAVE_ULTIMA, X);
+    }
+    REVISAR(SIGUIENTE_OTRAS(CLAVE_POSE(1)) == LOG_RANURA[CLAVE_POSE(1)], "La cabeza alcanza la ranura vigente de la clave");
+    memcpy(COPIA, SIM_EEPROM, sizeof(COPIA));
+    for(I = 0; I < 2 * LOG_TAM_REG; I++){
+        memcpy(SIM_EEPROM, COPIA, sizeof(COPIA));
+        REARRANCAR();
+        SIM_EE_CORTE = I;
+        LOG_ESCRIBIR(CLAVE_POSE(1), B);
+        SIM_EE_CORTE = -1;
+        REARRANCAR();
+        if(LOG_RANURA[CLAVE_POSE(1)] == LOG_VACIO || (memcmp(LOG_VALOR[CLAVE_POSE(1)], A, 4) != 0 &&
+                memcmp(LOG_VALOR[CLAVE_POSE(1)], B, 4) != 0)){
+            CONSERVA = 0;
+        }
+    }
+    REVISAR(CONSERVA, "Un corte al reescribir la clave conserva su valor anterior");
+    LOG_ESCRIBIR(CLAVE_POSE(1), B);
+    REARRANCAR();
+    REVISAR(memcmp(LOG_VALOR[CLAVE_POSE(1)], B, 4) == 0, "Sin corte queda el valor nuevo");
+}
+
+// Escrituras al azar con cortes de energa en cualquier byte: tras cada
+// arranque toda clave conserva su valor anterior o, la que se escriba, el
+// nuevo. Las claves se comparan con una copia propia de sus valores
+void PRUEBA_CORTES(void){
+    uint8_t ESPERADO[LOG_CLAVES][4];
+    uint8_t DATOS[4];
+    uint16_t AZAR = 12345;
+    uint16_t I;
+    uint8_t K, J, CLAVE, BIEN = 1;
+    uint16_t CORTES = 0;
+    REARRANCAR();
+    for(K = 0; K < LOG_CLAVES; K++){        // Todas las claves con un valor
+        for(J = 0; J < 4; J++){
+            DATOS[J] = K * 16 + J;
+        }
+        LOG_ESCRIBIR(K, DATOS);
+        memcpy(ESPERADO[K], DATOS, 4);
+    }
+    for(I = 0; I < 2000; I++){
+        AZAR = AZAR * 25173 + 13849;
+        CLAVE = (AZAR >> 8) % LOG_CLAVES;
+        for(J = 0; J < 4; J++){
+            DATOS[J] = (AZAR >> J) + I;
+        }
+        AZAR = AZAR * 25173 + 13849;
+        SIM_EE_CORTE = ((AZAR >> 8) & 0b11) ? -1 : (int16_t)((AZAR >> 10) % (3 * LOG_TAM_REG));
+        LOG_ESCRIBIR(CLAVE, DATOS);
+        if(SIM_EE_CORTE >= 0){
+            SIM_EE_CORTE = -1;
+            CORTES++;
+        }
+        REARRANCAR();
+        for(K = 0; K < LOG_CLAVES; K++){
+            if(LOG_RANURA[K] == LOG_VACIO){
+                BIEN = 0;
+            }
+            else if(K == CLAVE && memcmp(LOG_VALOR[K], DATOS, 4) == 0){
+                memcpy(ESPERADO[K], DATOS, 4);
+            }
+            else if(memcmp(LOG_VALOR[K], ESPERADO[K], 4) != 0){
+                BIEN = 0;
+            }
+        }
+    }
+    REVISAR(CORTES > 0 && BIEN, "El registro sobrevive a cortes de energa a mitad de escritura");
+}
+
+int main(void){
+    SIM_REINICIAR();
+    NUCLEO_INICIAR();
+    PRUEBA_TABLA();
+    PRUEBA_MANUAL();
+    PRUEBA_PROTOCOLO();
+    PRUEBA_MODO2();
+    PRUEBA_TELEMETRIA();
+    PRUEBA_TRANSPORTE();
+    PRUEBA_ESCLAVO_AUSENTE();
+#if TRANSPORTE_I2C
+    PRUEBA_COLISION();
+#endif
+    PRUEBA_REGISTRO();
+    PRUEBA_POSES();
+    PRUEBA_SECUENCIA();
+    PRUEBA_FLASH();
+    PRUEBA_COLA_TRAYECTORIA();
+    PRUEBA_CORTE_PROPIA();
+    PRUEBA_CORTES();
+    printf("%u fallas, %lu periodos de TMR0, %lu bytes por el MSSP\n",
+            FALLAS, (unsigned long)SIM_PERIODO, (unsigned long)SIM_BYTES_MSSP);
+    return FALLAS != 0;
+}
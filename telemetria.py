@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+# Decodificador de la telemetría del brazo (Maestro4EEPROMEUSART.c).
+# Activa la telemetría con CMD_TELEMETRIA y guarda cada trama en CSV:
+#   python3 telemetria.py /dev/ttyUSB0 --periodo 10 > registro.csv
+# Requiere pyserial.
+
+import argparse
+import sys
+import time
+
+import serial
+
+TRAMA_SYNC = 0xA5
+CMD_TELEMETRIA = 0x04
+CMD_RESPUESTA = 0x80
+TRAMA_TELEMETRIA = 0xC0
+TELEMETRIA_LEN = 10
+TRAMA_MAX = 10
+
+
+def crc8(crc, dato):
+    # CRC-8, polinomio 0x07, igual que CRC8() del firmware
+    crc ^= dato
+    for _ in range(8):
+        crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def trama(cmd, datos):
+    crc = crc8(crc8(0, cmd), len(datos))
+    for dato in datos:
+        crc = crc8(crc, dato)
+    return bytes([TRAMA_SYNC, cmd, len(datos)]) + bytes(datos) + bytes([crc])
+
+
+def leer_tramas(puerto):
+    # Misma máquina de estados que PROCESAR_USART: ante un error se vuelve a
+    # buscar el byte de sincronía. Si el puerto no entrega nada se produce
+    # (None, b'', errores)
+    errores = 0
+    while True:
+        b = puerto.read(1)
+        if not b:
+            yield None, b'', errores
+            continue
+        if b[0] != TRAMA_SYNC:
+            continue
+        cabecera = puerto.read(2)
+        if len(cabecera) < 2 or cabecera[1] > TRAMA_MAX:
+            errores += 1
+            continue
+        cmd, n = cabecera
+        resto = puerto.read(n + 1)
+        if len(resto) < n + 1:
+            errores += 1
+            continue
+        crc = crc8(crc8(0, cmd), n)
+        for dato in resto[:n]:
+            crc = crc8(crc, dato)
+        if crc != resto[n]:
+            errores += 1
+            continue
+        yield cmd, resto[:n], errores
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Registro de telemetría en CSV')
+    parser.add_argument('puerto')
+    parser.add_argument('--baudios', type=int, default=9600)
+    parser.add_argument('--periodo', type=int, default=10,
+                        help='unidades de 2 ms (10 -> 50 Hz; 5 -> 100 Hz solo a 19200)')
+    args = parser.parse_args()
+
+    # 14 bytes por trama y 10 bits por byte: a 9600 caben ~68 tramas/s
+    maximo = args.baudios / 10.0 / (TELEMETRIA_LEN + 4)
+    if args.periodo and 500.0 / args.periodo > maximo:
+        print('aviso: %.0f Hz no cabe a %d baudios (máximo ~%.0f tramas/s)' %
+              (500.0 / args.periodo, args.baudios, maximo), file=sys.stderr)
+
+    puerto = serial.Serial(args.puerto, args.baudios, timeout=1)
+    puerto.write(trama(CMD_TELEMETRIA, [args.periodo]))
+
+    print('tiempo,sec,modo,pot1,pot2,pot3,pot4,oerr,ferr,rx,trama,perdidas,crc_host')
+    sec_anterior = None
+    perdidas = 0
+    try:
+        for cmd, datos, errores in leer_tramas(puerto):
+            if cmd == CMD_TELEMETRIA | CMD_RESPUESTA:
+                if datos[0] != 0:
+                    print('telemetria rechazada, estado %d' % datos[0], file=sys.stderr)
+                continue
+            if cmd != TRAMA_TELEMETRIA or len(datos) != TELEMETRIA_LEN:
+                continue
+            if sec_anterior is not None:
+                perdidas += (datos[0] - sec_anterior - 1) & 0xFF
+            sec_anterior = datos[0]
+            print('%.3f,%s,%d,%d' % (time.time(), ','.join(str(d) for d in datos),
+                                     perdidas, errores), flush=True)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        puerto.write(trama(CMD_TELEMETRIA, [0]))
+        puerto.close()
+
+
+if __name__ == '__main__':
+    main()
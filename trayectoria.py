@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+# Envía una trayectoria al brazo en MODO 2 con CMD_TRAYECTORIA.
+# El archivo tiene una línea por punto: t_ms,pot1,pot2,pot3,pot4
+#   python3 trayectoria.py /dev/ttyUSB0 puntos.csv
+# Solo se envían tantos puntos como créditos (lugares libres) informa el
+# firmware, así la cola nunca se desborda. Requiere pyserial.
+
+import argparse
+import csv
+import time
+
+import serial
+
+from telemetria import CMD_RESPUESTA, leer_tramas, trama
+
+CMD_TRAYECTORIA = 0x05
+ESTADOS = {0: 'ok', 1: 'no esta en MODO 2', 2: 'invalido', 3: 'cola llena'}
+
+
+def leer_puntos(nombre):
+    with open(nombre) as archivo:
+        for fila in csv.reader(archivo):
+            if not fila or fila[0].startswith('#'):
+                continue
+            t_ms, *posiciones = (int(x) for x in fila)
+            yield (t_ms // 2) & 0xFFFF, posiciones   # Periodos de TMR0 (2 ms)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Trayectoria por USART')
+    parser.add_argument('puerto')
+    parser.add_argument('archivo')
+    parser.add_argument('--baudios', type=int, default=9600)
+    args = parser.parse_args()
+
+    puerto = serial.Serial(args.puerto, args.baudios, timeout=0.2)
+    respuestas = leer_tramas(puerto)
+
+    def pedir(datos):
+        # Si la respuesta se pierde solo se vuelven a consultar los créditos:
+        # reenviar el punto podría duplicarlo en la cola
+        puerto.write(trama(CMD_TRAYECTORIA, datos))
+        for cmd, resp, _ in respuestas:
+            if cmd is None:
+                puerto.write(trama(CMD_TRAYECTORIA, []))
+            elif cmd == CMD_TRAYECTORIA | CMD_RESPUESTA and len(resp) == 2:
+                return resp[0], resp[1]
+
+    estado, creditos = pedir([])
+    for t, posiciones in leer_puntos(args.archivo):
+        while creditos == 0:
+            time.sleep(0.02)
+            estado, creditos = pedir([])
+        estado, creditos = pedir([t & 0xFF, t >> 8] + posiciones)
+        if estado != 0:
+            raise SystemExit('punto en t=%d rechazado: %s' % (t * 2, ESTADOS.get(estado)))
+    puerto.close()
+
+
+if __name__ == '__main__':
+    main()